@@ -0,0 +1,262 @@
+// Benchmark de arranque en frio: apertura de una imagen existente (constructor
+// -> init_file_system() -> initialize_disk()), primera lectura de un archivo y
+// cierre (reescritura completa de la imagen en el destructor).
+//
+// Cada imagen se llena una vez con archivos de tamano variable y un historial
+// de versiones (ediciones pequenas, anexos y truncados); despues se repite el
+// ciclo abrir -> primera lectura -> cerrar. Antes de cada apertura se expulsan
+// de la cache de paginas los datos de la imagen (salvo con --warm).
+//
+// Uso: bench_coldstart [--image-sizes=10M,100M,1G] [--iterations=3]
+//                      [--fill=50] [--files=256] [--versions=8] [--warm]
+//                      [--format=json|text] [--dir=.]
+
+#include "bench_common.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "coldstart";
+const size_t FIRST_READ_SIZE = BLOCK_SIZE;
+
+struct Config {
+    size_t iterations;
+    size_t fill_pct;
+    size_t files;
+    size_t versions;
+    bool warm;
+};
+
+struct Population {
+    size_t files = 0;
+    size_t versions = 0;
+    double populate_ns = 0;
+};
+
+std::string file_name(size_t index) {
+    return "cold_" + std::to_string(index) + ".dat";
+}
+
+// Llena la imagen hasta fill_pct con archivos y su historial de versiones
+Population populate(const std::string& path, size_t image_size, const Config& config) {
+    Population population;
+    size_t target = image_size / 100 * config.fill_pct;
+    size_t files = std::min<size_t>(std::max<size_t>(1, config.files), MAX_FILES);
+    // Una version guarda desde delta_start hasta el final del archivo: en
+    // promedio la mitad del contenido por cada version posterior a la primera
+    size_t footprint = 2 + (config.versions - 1);
+    size_t mean_size = std::max<size_t>(BLOCK_SIZE, target / files * 2 / footprint);
+    std::mt19937_64 rng(image_size);
+
+    population.populate_ns = time_ns([&]() {
+        COWFileSystem fs(path, image_size);
+        for (size_t f = 0; f < files && fs.get_total_memory_usage() < target; ++f) {
+            fd_t fd = fs.create(file_name(f));
+            if (fd < 0) {
+                break;
+            }
+            // Tamanos entre la mitad y 1.5 veces la media
+            size_t size = mean_size / 2 + rng() % (mean_size + 1);
+            std::vector<uint8_t> content = random_bytes(size, f + 1);
+            if (fs.write(fd, content.data(), content.size()) < 0) {
+                fs.close(fd);
+                break;
+            }
+            population.files++;
+            population.versions++;
+
+            for (size_t v = 1; v < config.versions; ++v) {
+                unsigned dice = static_cast<unsigned>(rng() % 100);
+                if (dice < 70 || content.size() < 2 * BLOCK_SIZE) {
+                    size_t offset = rng() % content.size();
+                    size_t length = std::min<size_t>(256, content.size() - offset);
+                    for (size_t i = 0; i < length; ++i) {
+                        content[offset + i] = static_cast<uint8_t>(rng());
+                    }
+                } else if (dice < 90) {
+                    std::vector<uint8_t> tail = random_bytes(1024, rng());
+                    content.insert(content.end(), tail.begin(), tail.end());
+                } else {
+                    content.resize(content.size() - 1024);
+                }
+                if (fs.write(fd, content.data(), content.size()) < 0) {
+                    break;
+                }
+                population.versions++;
+            }
+            fs.close(fd);
+        }
+    });
+    return population;
+}
+
+// Expulsa de la cache de paginas los datos de la imagen para que la apertura
+// lea del dispositivo
+void drop_page_cache(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+// Valor en bytes de un campo de /proc/self/status (VmRSS, VmHWM), 0 si no existe
+size_t proc_status_bytes(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") == 0) {
+            return std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) * 1024;
+        }
+    }
+    return 0;
+}
+
+// Reinicia VmHWM al RSS actual (Linux >= 4.0); false si no se puede
+bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+size_t file_bytes(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+void bench_image_size(const Options& options, Reporter& reporter, const Config& config,
+                      size_t image_size) {
+    TempImage image(options, "coldstart");
+    Population population = populate(image.path(), image_size, config);
+    size_t image_bytes = file_bytes(image.path());
+
+    std::vector<double> open_samples;
+    std::vector<double> first_read_samples;
+    std::vector<double> flush_samples;
+    size_t peak_rss_delta = 0;
+    size_t peak_rss = 0;
+    bool peak_reset = true;
+    std::vector<uint8_t> buffer(FIRST_READ_SIZE);
+    // Un grupo por fase: time_to_first_read suma los de apertura y lectura
+    PerfCounters open_counters, read_counters, flush_counters;
+    open_like_main(open_counters);
+    open_like_main(read_counters);
+    open_like_main(flush_counters);
+
+    for (size_t i = 0; i < config.iterations; ++i) {
+        if (!config.warm) {
+            drop_page_cache(image.path());
+        }
+        peak_reset = reset_peak_rss() && peak_reset;
+        size_t rss_before = proc_status_bytes("VmRSS");
+
+        std::unique_ptr<COWFileSystem> fs;
+        double open_ns = time_ns(open_counters, [&]() { fs.reset(new COWFileSystem(image.path(), image_size)); });
+        double read_ns = time_ns(read_counters, [&]() {
+            fd_t fd = fs->open(file_name(i % std::max<size_t>(1, population.files)), FileMode::READ);
+            fs->read(fd, buffer.data(), buffer.size());
+            fs->close(fd);
+        });
+
+        size_t hwm = proc_status_bytes("VmHWM");
+        peak_rss = std::max(peak_rss, hwm);
+        peak_rss_delta = std::max(peak_rss_delta, hwm > rss_before ? hwm - rss_before : 0);
+
+        open_samples.push_back(open_ns);
+        first_read_samples.push_back(open_ns + read_ns);
+        flush_samples.push_back(time_ns(flush_counters, [&]() { fs.reset(); }));
+    }
+
+    auto make_result = [&](const std::string& name, const std::vector<double>& samples) {
+        Result result;
+        result.suite = SUITE;
+        result.name = name;
+        result.params.emplace_back("image_size", image_size);
+        result.params.emplace_back("files", population.files);
+        result.params.emplace_back("versions", population.versions);
+        result.summary = summarize(samples);
+        return result;
+    };
+
+    if (name_selected(options, "open")) {
+        Result result = make_result("open", open_samples);
+        result.bytes_per_op = image_bytes;
+        result.metrics.emplace_back("populate_ms", population.populate_ns / 1e6);
+        perf_counters().reset();
+        perf_counters().merge(open_counters);
+        reporter.report(result);
+    }
+    if (name_selected(options, "time_to_first_read")) {
+        Result result = make_result("time_to_first_read", first_read_samples);
+        // Sin clear_refs VmHWM es el maximo de todo el proceso
+        result.metrics.emplace_back("peak_rss_bytes", static_cast<double>(peak_rss));
+        result.metrics.emplace_back("peak_rss_delta_bytes",
+                                    peak_reset ? static_cast<double>(peak_rss_delta) : -1.0);
+        perf_counters().reset();
+        perf_counters().merge(open_counters);
+        perf_counters().merge(read_counters, true);
+        reporter.report(result);
+    }
+    if (name_selected(options, "shutdown_flush")) {
+        Result result = make_result("shutdown_flush", flush_samples);
+        result.bytes_per_op = image_bytes;
+        perf_counters().reset();
+        perf_counters().merge(flush_counters);
+        reporter.report(result);
+    }
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_coldstart [options]\n"
+              << "  --image-sizes=LIST        image sizes (default 10M,100M,1G; e.g. 16G needs 16G of RAM)\n"
+              << "  --iterations=N            open/read/close cycles per image (default 3)\n"
+              << "  --fill=PCT                share of the image filled before measuring (default 50)\n"
+              << "  --files=N                 number of files, at most " << MAX_FILES << " (default 256)\n"
+              << "  --versions=N              versions written to each file (default 8)\n"
+              << "  --warm                    keep the image in the page cache between opens\n"
+              << "  --filter=TEXT             only report results whose name contains TEXT\n"
+              << "  --format=json|text        output format (default json)\n"
+              << "  --dir=PATH                directory for temporary images (default .)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.iterations = std::max<size_t>(1, options.get_size("iterations", 3));
+    config.fill_pct = std::min<size_t>(90, options.get_size("fill", 50));
+    config.files = options.get_size("files", 256);
+    config.versions = std::max<size_t>(1, options.get_size("versions", 8));
+    config.warm = options.has("warm");
+
+    Reporter reporter(options);
+    try {
+        for (size_t image_size : options.get_sizes("image-sizes", {10u << 20, 100u << 20, 1u << 30})) {
+            if (image_size < 64 * BLOCK_SIZE) {
+                std::cerr << "Skipping image size " << image_size << " (too small)" << std::endl;
+                continue;
+            }
+            bench_image_size(options, reporter, config, image_size);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
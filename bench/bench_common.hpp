@@ -0,0 +1,636 @@
+#ifndef COWFS_BENCH_COMMON_HPP
+#define COWFS_BENCH_COMMON_HPP
+
+// Utilidades compartidas por los benchmarks: opciones de linea de comandos,
+// medicion, resumen estadistico y salida legible por maquina (JSON lines).
+
+#include "cowfs.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cowfs {
+namespace bench {
+
+// Acceso a metodos privados de COWFileSystem (declarado friend en cowfs.hpp)
+struct Internals {
+    static bool find_delta(COWFileSystem& fs, const void* old_data, const void* new_data,
+                           size_t old_size, size_t new_size,
+                           size_t& delta_start, size_t& delta_size) {
+        return fs.find_delta(old_data, new_data, old_size, new_size, delta_start, delta_size);
+    }
+
+    static bool allocate_block(COWFileSystem& fs, size_t& block_index) {
+        return fs.allocate_block(block_index);
+    }
+
+    // Reemplaza la lista de bloques libres por los rangos indicados
+    static void set_free_extents(COWFileSystem& fs,
+                                 const std::vector<std::pair<size_t, size_t>>& extents) {
+        fs.clear_free_list();
+        for (const auto& extent : extents) {
+            fs.add_to_free_list(extent.first, extent.second);
+        }
+    }
+
+    // No hay lseek en la API publica; los benchmarks de lectura aleatoria
+    // posicionan el descriptor directamente
+    static void seek(COWFileSystem& fs, fd_t fd, size_t position) {
+        fs.file_descriptors[fd].current_position = position;
+    }
+
+    // Lee los primeros size bytes de una version anterior sin hacer rollback
+    static bool read_version_data(COWFileSystem& fs, fd_t fd, size_t version,
+                                  void* buffer, size_t& size) {
+        return fs.read_version_data(version, fd, buffer, size);
+    }
+
+    static std::vector<std::pair<size_t, size_t>> free_extents(const COWFileSystem& fs) {
+        std::vector<std::pair<size_t, size_t>> extents;
+        for (const FreeBlockInfo* extent = fs.free_blocks_list; extent; extent = extent->next) {
+            extents.emplace_back(extent->start_block, extent->block_count);
+        }
+        return extents;
+    }
+
+    static Inode* find_inode(COWFileSystem& fs, const std::string& filename) {
+        return fs.find_inode(filename);
+    }
+
+    static size_t total_blocks(const COWFileSystem& fs) {
+        return fs.total_blocks;
+    }
+};
+
+// Opciones --clave=valor; las listas se separan por comas y los tamanos
+// aceptan sufijos K, M y G (potencias de 1024)
+class Options {
+public:
+    Options(int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                values["help"] = "1";
+                continue;
+            }
+            if (arg.rfind("--", 0) != 0) {
+                std::cerr << "Ignoring argument: " << arg << std::endl;
+                continue;
+            }
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                values[arg.substr(2)] = "1";
+            } else {
+                values[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    bool has(const std::string& key) const { return values.count(key) > 0; }
+
+    std::string get_string(const std::string& key, const std::string& fallback) const {
+        auto it = values.find(key);
+        return it == values.end() ? fallback : it->second;
+    }
+
+    // --clave o --clave=1 activan la opcion y --clave=0 la desactiva.
+    // Lanza std::invalid_argument con cualquier otro valor
+    bool get_flag(const std::string& key) const {
+        auto it = values.find(key);
+        if (it == values.end() || it->second == "0" || it->second == "false" || it->second == "no") {
+            return false;
+        }
+        if (it->second == "1" || it->second == "true" || it->second == "yes") {
+            return true;
+        }
+        throw std::invalid_argument("--" + key + " expects 0 or 1, got '" + it->second + "'");
+    }
+
+    size_t get_size(const std::string& key, size_t fallback) const {
+        auto it = values.find(key);
+        return it == values.end() ? fallback : parse_size(it->second);
+    }
+
+    double get_double(const std::string& key, double fallback) const {
+        auto it = values.find(key);
+        return it == values.end() ? fallback : std::strtod(it->second.c_str(), nullptr);
+    }
+
+    std::vector<size_t> get_sizes(const std::string& key, const std::vector<size_t>& fallback) const {
+        auto it = values.find(key);
+        if (it == values.end()) {
+            return fallback;
+        }
+        std::vector<size_t> result;
+        std::stringstream ss(it->second);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) {
+                result.push_back(parse_size(item));
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::string> get_strings(const std::string& key, const std::string& fallback) const {
+        std::vector<std::string> result;
+        std::stringstream ss(get_string(key, fallback));
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+
+    static size_t parse_size(const std::string& text) {
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (end && *end) {
+            switch (*end) {
+                case 'k': case 'K': value *= 1024.0; break;
+                case 'm': case 'M': value *= 1024.0 * 1024.0; break;
+                case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; break;
+                default: break;
+            }
+        }
+        return static_cast<size_t>(value);
+    }
+
+private:
+    std::map<std::string, std::string> values;
+};
+
+struct Summary {
+    size_t samples = 0;
+    double min_ns = 0;
+    double max_ns = 0;
+    double mean_ns = 0;
+    double median_ns = 0;
+    double p90_ns = 0;
+    double p99_ns = 0;
+    double p999_ns = 0;
+    double stddev_ns = 0;
+};
+
+inline Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    summary.samples = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double v : samples) {
+        sum += v;
+    }
+    summary.min_ns = samples.front();
+    summary.max_ns = samples.back();
+    summary.mean_ns = sum / static_cast<double>(samples.size());
+    size_t mid = samples.size() / 2;
+    summary.median_ns = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2.0;
+    auto percentile = [&samples](double q) {
+        size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(samples.size())));
+        return samples[std::min(rank > 0 ? rank - 1 : 0, samples.size() - 1)];
+    };
+    summary.p90_ns = percentile(0.90);
+    summary.p99_ns = percentile(0.99);
+    summary.p999_ns = percentile(0.999);
+    double variance = 0;
+    for (double v : samples) {
+        variance += (v - summary.mean_ns) * (v - summary.mean_ns);
+    }
+    summary.stddev_ns = std::sqrt(variance / static_cast<double>(samples.size()));
+    return summary;
+}
+
+// Resultado de un benchmark: parametros (enteros) y metricas adicionales
+struct Result {
+    std::string suite;
+    std::string name;
+    std::vector<std::pair<std::string, size_t>> params;
+    Summary summary;
+    // Bytes procesados por operacion medida (0 si no aplica)
+    size_t bytes_per_op = 0;
+    std::vector<std::pair<std::string, double>> metrics;
+    // Valores de texto, como la configuracion obtenida; van al final y no
+    // forman parte de la clave del resultado
+    std::vector<std::pair<std::string, std::string>> labels;
+    // false en registros que no miden tiempo (espacio ocupado, por ejemplo):
+    // se omiten samples, latencias y contadores, y la puerta los ignora
+    bool timed = true;
+};
+
+// Contadores hardware (perf_event_open) del hilo que mide: ciclos,
+// instrucciones, fallos de cache y de TLB y fallos de prediccion de saltos.
+// Cuentan solo en modo usuario, que es lo que permite perf_event_paranoid = 2.
+// Los eventos que el kernel o la CPU no ofrecen (contenedores, maquinas
+// virtuales, otros sistemas) se omiten sin error.
+class PerfCounters {
+public:
+    enum Event { CYCLES = 0, INSTRUCTIONS, CACHE_MISSES, DTLB_MISSES, BRANCH_MISSES, EVENT_COUNT };
+
+    PerfCounters() = default;
+    ~PerfCounters() { close_all(); }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Abre los eventos disponibles; devuelve false si no hay ninguno
+    bool open() {
+        close_all();
+#ifdef __linux__
+        const uint64_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB |
+                                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const std::pair<uint32_t, uint64_t> configs[EVENT_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HW_CACHE, dtlb_read_miss},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        // Todos los eventos en un grupo para que se planifiquen juntos; el
+        // primero que se abre es el lider
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = configs[e].first;
+            attr.config = configs[e].second;
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fds[e] >= 0 && leader < 0) {
+                leader = fds[e];
+            }
+        }
+#endif
+        reset();
+        return leader >= 0;
+    }
+
+    bool available() const { return leader >= 0; }
+    bool has(Event event) const { return fds[event] >= 0; }
+
+    void reset() {
+        operations = 0;
+        for (auto& total : totals) {
+            total = 0;
+        }
+    }
+
+    void start() {
+#ifdef __linux__
+        if (leader >= 0) {
+            read_all(begin);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    // Acumula lo contado desde start() como una operacion mas
+    void stop() {
+#ifdef __linux__
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            double end[EVENT_COUNT];
+            read_all(end);
+            for (int e = 0; e < EVENT_COUNT; ++e) {
+                totals[e] += end[e] - begin[e];
+            }
+            operations++;
+        }
+#endif
+    }
+
+    // Suma lo acumulado por otro grupo, por ejemplo el de un hilo de trabajo.
+    // Con same_operations, other conto otra fase de las mismas operaciones y
+    // solo se suman sus eventos
+    void merge(const PerfCounters& other, bool same_operations = false) {
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            totals[e] += other.totals[e];
+        }
+        if (!same_operations) {
+            operations += other.operations;
+        }
+    }
+
+    // Anade las medias por operacion acumuladas desde el ultimo reset()
+    void append_metrics(std::vector<std::pair<std::string, double>>& metrics) const {
+        if (operations == 0) {
+            return;
+        }
+        static const char* const names[EVENT_COUNT] = {
+            "cycles_per_op", "instructions_per_op", "cache_misses_per_op",
+            "dtlb_misses_per_op", "branch_misses_per_op",
+        };
+        double ops = static_cast<double>(operations);
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            if (fds[e] >= 0) {
+                metrics.emplace_back(names[e], totals[e] / ops);
+            }
+        }
+        if (fds[CYCLES] >= 0 && fds[INSTRUCTIONS] >= 0 && totals[CYCLES] > 0) {
+            metrics.emplace_back("ipc", totals[INSTRUCTIONS] / totals[CYCLES]);
+        }
+    }
+
+private:
+    int fds[EVENT_COUNT] = {-1, -1, -1, -1, -1};
+    int leader = -1;
+    double begin[EVENT_COUNT] = {};
+    double totals[EVENT_COUNT] = {};
+    uint64_t operations = 0;
+
+    void close_all() {
+#ifdef __linux__
+        for (auto& fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            fd = -1;
+        }
+#endif
+        leader = -1;
+    }
+
+#ifdef __linux__
+    // Valor de cada evento escalado si el kernel lo multiplexo
+    void read_all(double (&values)[EVENT_COUNT]) const {
+        for (int e = 0; e < EVENT_COUNT; ++e) {
+            uint64_t data[3] = {0, 0, 0};
+            values[e] = 0;
+            if (fds[e] >= 0 && ::read(fds[e], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data))) {
+                values[e] = data[2] > 0 ? static_cast<double>(data[0]) * static_cast<double>(data[1]) /
+                                          static_cast<double>(data[2])
+                                        : static_cast<double>(data[0]);
+            }
+        }
+    }
+#endif
+};
+
+// Contadores del hilo principal, usados por measure() y Reporter. Los
+// benchmarks que separan varias fases o usan hilos de trabajo abren sus
+// propios grupos solo si estos estan disponibles y los suman aqui con
+// merge() antes de Reporter::report()
+inline PerfCounters& perf_counters() {
+    static PerfCounters counters;
+    return counters;
+}
+
+// Abre un grupo adicional si los contadores del hilo principal estan
+// abiertos (sin --perf=0 y con eventos disponibles). Se abre en el hilo
+// que va a medir, porque perf_event_open cuenta solo ese hilo
+inline void open_like_main(PerfCounters& counters) {
+    if (perf_counters().available()) {
+        counters.open();
+    }
+}
+
+class Reporter {
+public:
+    // Con --perf (activo salvo --perf=0) se abren los contadores hardware
+    explicit Reporter(const Options& options)
+        : json(options.get_string("format", "json") == "json") {
+        if (options.get_string("perf", "1") != "0" && !perf_counters().open() &&
+            options.has("perf")) {
+            std::cerr << "Hardware performance counters are not available" << std::endl;
+        }
+    }
+
+    // Los contadores acumulados por el ultimo measure() se anaden al
+    // resultado como metricas por operacion
+    void report(const Result& result) {
+        Result annotated = result;
+        if (annotated.timed) {
+            perf_counters().append_metrics(annotated.metrics);
+        }
+        perf_counters().reset();
+        if (json) {
+            report_json(annotated);
+        } else {
+            report_text(annotated);
+        }
+    }
+
+private:
+    bool json;
+
+    static double per_second(double value, double ns) {
+        return ns > 0 ? value * 1e9 / ns : 0.0;
+    }
+
+    void report_json(const Result& result) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        out << "{\"suite\":\"" << result.suite << "\",\"name\":\"" << result.name << "\"";
+        for (const auto& param : result.params) {
+            out << ",\"" << param.first << "\":" << param.second;
+        }
+        const Summary& s = result.summary;
+        if (result.timed) {
+            out << ",\"samples\":" << s.samples
+                << ",\"median_ns\":" << s.median_ns
+                << ",\"mean_ns\":" << s.mean_ns
+                << ",\"p90_ns\":" << s.p90_ns
+                << ",\"p99_ns\":" << s.p99_ns
+                << ",\"p999_ns\":" << s.p999_ns
+                << ",\"min_ns\":" << s.min_ns
+                << ",\"max_ns\":" << s.max_ns
+                << ",\"stddev_ns\":" << s.stddev_ns
+                << ",\"ops_per_sec\":" << per_second(1.0, s.median_ns);
+        } else {
+            out << ",\"timed\":false";
+        }
+        if (result.timed && result.bytes_per_op > 0) {
+            out << ",\"bytes_per_op\":" << result.bytes_per_op
+                << ",\"bytes_per_sec\":" << per_second(static_cast<double>(result.bytes_per_op), s.median_ns);
+        }
+        for (const auto& metric : result.metrics) {
+            out << ",\"" << metric.first << "\":" << metric.second;
+        }
+        for (const auto& label : result.labels) {
+            out << ",\"" << label.first << "\":\"" << label.second << "\"";
+        }
+        out << "}";
+        std::cout << out.str() << std::endl;
+    }
+
+    void report_text(const Result& result) {
+        std::ostringstream label;
+        label << result.suite << "/" << result.name;
+        for (const auto& param : result.params) {
+            label << " " << param.first << "=" << param.second;
+        }
+        const Summary& s = result.summary;
+        std::cout << std::left << std::setw(60) << label.str() << std::right << std::fixed
+                  << std::setprecision(0);
+        if (result.timed) {
+            std::cout << " median " << std::setw(12) << s.median_ns << " ns"
+                      << "  p99 " << std::setw(12) << s.p99_ns << " ns";
+        }
+        if (result.timed && result.bytes_per_op > 0) {
+            std::cout << std::setprecision(1) << "  "
+                      << per_second(static_cast<double>(result.bytes_per_op), s.median_ns) / (1024.0 * 1024.0)
+                      << " MB/s";
+        }
+        for (const auto& metric : result.metrics) {
+            std::cout << std::setprecision(2) << "  " << metric.first << "=" << metric.second;
+        }
+        for (const auto& label : result.labels) {
+            std::cout << "  " << label.first << "=" << label.second;
+        }
+        std::cout << std::endl;
+    }
+};
+
+template <typename Fn>
+inline double time_ns(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// time_ns() que ademas acumula los contadores hardware de fn como una operacion
+template <typename Fn>
+inline double time_ns(PerfCounters& perf, Fn&& fn) {
+    perf.start();
+    double elapsed = time_ns(std::forward<Fn>(fn));
+    perf.stop();
+    return elapsed;
+}
+
+// Ejecuta setup (sin medir) y body (medido) el numero de iteraciones pedido.
+// Si hay contadores hardware, se cuentan solo durante body
+template <typename Setup, typename Body>
+inline std::vector<double> measure(size_t iterations, Setup&& setup, Body&& body) {
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    PerfCounters& perf = perf_counters();
+    perf.reset();
+    for (size_t i = 0; i < iterations; ++i) {
+        setup(i);
+        perf.start();
+        samples.push_back(time_ns([&]() { body(i); }));
+        perf.stop();
+    }
+    return samples;
+}
+
+// Imagen temporal que se borra al salir del ambito. Debe declararse antes
+// del COWFileSystem, cuyo destructor vuelve a escribir el archivo.
+class TempImage {
+public:
+    explicit TempImage(const Options& options, const std::string& tag) {
+        static int counter = 0;
+        std::ostringstream name;
+        name << options.get_string("dir", ".") << "/cowfs_bench_" << tag << "_" << counter++ << ".img";
+        image_path = name.str();
+        std::remove(image_path.c_str());
+    }
+
+    ~TempImage() { std::remove(image_path.c_str()); }
+
+    TempImage(const TempImage&) = delete;
+    TempImage& operator=(const TempImage&) = delete;
+
+    const std::string& path() const { return image_path; }
+
+private:
+    std::string image_path;
+};
+
+inline std::vector<uint8_t> random_bytes(size_t size, uint64_t seed) {
+    std::vector<uint8_t> data(size);
+    std::mt19937_64 rng(seed);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t value = rng();
+        std::memcpy(data.data() + i, &value, 8);
+    }
+    for (; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+// Silencia el log en tiempo de ejecucion (en builds sin NDEBUG sigue compilado)
+inline void quiet_logging(const Options& options) {
+    if (!options.has("verbose")) {
+        set_log_level(LogLevel::OFF);
+    }
+}
+
+// --huge-pages=none|transparent|explicit, --prefault y --mlock. Lanza
+// std::invalid_argument con un valor desconocido
+inline ArenaOptions arena_options(const Options& options) {
+    ArenaOptions arena;
+    std::string huge_pages = options.get_string("huge-pages", "none");
+    if (huge_pages == "transparent") {
+        arena.huge_pages = HugePages::TRANSPARENT;
+    } else if (huge_pages == "explicit") {
+        arena.huge_pages = HugePages::EXPLICIT;
+    } else if (huge_pages != "none") {
+        throw std::invalid_argument("--huge-pages expects none, transparent or explicit, got '" +
+                                    huge_pages + "'");
+    }
+    arena.prefault = options.get_flag("prefault");
+    arena.lock = options.get_flag("mlock");
+    return arena;
+}
+
+// Modo obtenido por una parte de la arena, p. ej. "transparent+prefault+mlock"
+inline std::string arena_mode_label(const ArenaStatus& status) {
+    std::string label = huge_pages_name(status.huge_pages);
+    if (status.prefaulted) {
+        label += "+prefault";
+    }
+    if (status.locked) {
+        label += "+mlock";
+    }
+    return label;
+}
+
+// La arena puede quedarse por debajo de lo pedido (sin pool de paginas
+// grandes, RLIMIT_MEMLOCK) y el registro de la biblioteca esta apagado:
+// cada resultado lleva lo que obtuvo su sistema de archivos
+inline void add_arena_labels(Result& result, const COWFileSystem& fs) {
+    BlockArenaStatus status = fs.arena_status();
+    result.labels.emplace_back("arena_content", arena_mode_label(status.content));
+    result.labels.emplace_back("arena_headers", arena_mode_label(status.headers));
+}
+
+inline bool name_selected(const Options& options, const std::string& name) {
+    std::string filter = options.get_string("filter", "");
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+} // namespace bench
+} // namespace cowfs
+
+#endif // COWFS_BENCH_COMMON_HPP
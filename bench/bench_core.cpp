@@ -0,0 +1,428 @@
+// Microbenchmarks de las operaciones principales del sistema de archivos:
+// read(), write(), find_delta(), allocate_block(), rollback_to_version() y
+// garbage_collect(), parametrizados por tamano de archivo y de imagen.
+//
+// Uso: bench_core [--file-sizes=4K,64K,1M] [--image-sizes=16M,64M]
+//                 [--iterations=50] [--versions=16] [--chunk=64K]
+//                 [--filter=read] [--format=json|text] [--dir=.]
+//                 [--huge-pages=none|transparent|explicit] [--prefault] [--mlock]
+
+#include "bench_common.hpp"
+#include <memory>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "core";
+
+struct Config {
+    size_t iterations;
+    size_t versions;
+    size_t chunk;
+};
+
+// Sistema de archivos de prueba con un archivo ya escrito (una version)
+class Fixture {
+public:
+    Fixture(const Options& options, size_t image_size, size_t file_size, uint64_t seed)
+        : image(options, "core"),
+          fs(new COWFileSystem(image.path(), image_size, TieringOptions(), arena_options(options))),
+          content(random_bytes(file_size, seed)),
+          current(content),
+          image_size_bytes(image_size) {
+        fd = fs->create("bench_file");
+        if (fd >= 0 && !content.empty()) {
+            fs->write(fd, content.data(), content.size());
+        }
+    }
+
+    bool ok() const { return fd >= 0; }
+
+    // Vuelve a la primera version y recupera el espacio del resto
+    void reset_versions() {
+        fs->rollback_to_version(fd, 1);
+        fs->garbage_collect();
+        current = content;
+    }
+
+    void ensure_space(size_t needed) {
+        if (fs->get_total_memory_usage() + needed + 2 * BLOCK_SIZE >= image_size_bytes) {
+            reset_versions();
+        }
+    }
+
+    TempImage image;
+    std::unique_ptr<COWFileSystem> fs;
+    std::vector<uint8_t> content;
+    std::vector<uint8_t> current;
+    size_t image_size_bytes;
+    fd_t fd = -1;
+};
+
+Result make_result(const COWFileSystem& fs, const std::string& name, size_t file_size, size_t image_size,
+                   const std::vector<double>& samples, size_t bytes_per_op) {
+    Result result;
+    result.suite = SUITE;
+    result.name = name;
+    add_arena_labels(result, fs);
+    if (file_size > 0) {
+        result.params.emplace_back("file_size", file_size);
+    }
+    if (image_size > 0) {
+        result.params.emplace_back("image_size", image_size);
+    }
+    result.summary = summarize(samples);
+    result.bytes_per_op = bytes_per_op;
+    return result;
+}
+
+void bench_read(const Options& options, Reporter& reporter, const Config& config,
+                size_t image_size, size_t file_size) {
+    Fixture fixture(options, image_size, file_size, 1);
+    if (!fixture.ok()) {
+        return;
+    }
+    COWFileSystem& fs = *fixture.fs;
+    std::vector<uint8_t> buffer(std::max(config.chunk, BLOCK_SIZE));
+    std::mt19937_64 rng(42);
+
+    if (name_selected(options, "read.sequential")) {
+        auto samples = measure(config.iterations,
+            [&](size_t) { Internals::seek(fs, fixture.fd, 0); },
+            [&](size_t) {
+                while (fs.read(fixture.fd, buffer.data(), config.chunk) > 0) {
+                }
+            });
+        reporter.report(make_result(fs, "read.sequential", file_size, image_size, samples, file_size));
+    }
+
+    size_t read_size = std::min(BLOCK_SIZE, file_size);
+    if (name_selected(options, "read.random")) {
+        size_t positions = file_size > read_size ? file_size - read_size + 1 : 1;
+        auto samples = measure(config.iterations,
+            [&](size_t) { Internals::seek(fs, fixture.fd, rng() % positions); },
+            [&](size_t) { fs.read(fixture.fd, buffer.data(), read_size); });
+        reporter.report(make_result(fs, "read.random", file_size, image_size, samples, read_size));
+    }
+
+    if (name_selected(options, "read.tail")) {
+        auto samples = measure(config.iterations,
+            [&](size_t) { Internals::seek(fs, fixture.fd, file_size - read_size); },
+            [&](size_t) { fs.read(fixture.fd, buffer.data(), read_size); });
+        reporter.report(make_result(fs, "read.tail", file_size, image_size, samples, read_size));
+    }
+}
+
+void bench_write(const Options& options, Reporter& reporter, const Config& config,
+                 size_t image_size, size_t file_size) {
+    if (name_selected(options, "write.first_version")) {
+        // Cada iteracion crea un archivo nuevo; la imagen se recrea cuando se
+        // agotan los inodos o el espacio
+        std::unique_ptr<Fixture> fixture;
+        size_t files_created = 0;
+        std::vector<uint8_t> content = random_bytes(file_size, 2);
+        fd_t fd = -1;
+        auto samples = measure(config.iterations,
+            [&](size_t i) {
+                if (!fixture || files_created + 1 >= MAX_FILES ||
+                    fixture->fs->get_total_memory_usage() + file_size + 2 * BLOCK_SIZE >= image_size) {
+                    fixture.reset();
+                    fixture.reset(new Fixture(options, image_size, 0, 2));
+                    files_created = 1;
+                }
+                fd = fixture->fs->create("first_" + std::to_string(i));
+                files_created++;
+            },
+            [&](size_t) { fixture->fs->write(fd, content.data(), content.size()); });
+        reporter.report(make_result(*fixture->fs, "write.first_version", file_size, image_size, samples, file_size));
+    }
+
+    Fixture fixture(options, image_size, file_size, 3);
+    if (!fixture.ok()) {
+        return;
+    }
+    COWFileSystem& fs = *fixture.fs;
+
+    if (name_selected(options, "write.small_edit")) {
+        auto samples = measure(config.iterations,
+            [&](size_t) {
+                fixture.ensure_space(file_size);
+                fixture.current[file_size / 2] ^= 0xFF;
+            },
+            [&](size_t) { fs.write(fixture.fd, fixture.current.data(), fixture.current.size()); });
+        reporter.report(make_result(fs, "write.small_edit", file_size, image_size, samples, file_size));
+    }
+
+    if (name_selected(options, "write.full_rewrite")) {
+        std::vector<uint8_t> alternate = random_bytes(file_size, 4);
+        auto samples = measure(config.iterations,
+            [&](size_t) {
+                fixture.ensure_space(file_size);
+                std::swap(fixture.current, alternate);
+            },
+            [&](size_t) { fs.write(fixture.fd, fixture.current.data(), fixture.current.size()); });
+        reporter.report(make_result(fs, "write.full_rewrite", file_size, image_size, samples, file_size));
+    }
+
+    if (name_selected(options, "write.append")) {
+        fixture.reset_versions();
+        std::vector<uint8_t> tail = random_bytes(BLOCK_SIZE, 5);
+        auto samples = measure(config.iterations,
+            [&](size_t) {
+                fixture.ensure_space(fixture.current.size() + BLOCK_SIZE);
+                fixture.current.insert(fixture.current.end(), tail.begin(), tail.end());
+            },
+            [&](size_t) { fs.write(fixture.fd, fixture.current.data(), fixture.current.size()); });
+        reporter.report(make_result(fs, "write.append", file_size, image_size, samples, BLOCK_SIZE));
+    }
+}
+
+void bench_find_delta(const Options& options, Reporter& reporter, const Config& config,
+                      size_t image_size, size_t file_size) {
+    TempImage image(options, "delta");
+    COWFileSystem fs(image.path(), image_size, TieringOptions(), arena_options(options));
+    std::vector<uint8_t> old_data = random_bytes(file_size, 6);
+
+    const std::pair<const char*, size_t> cases[] = {
+        {"find_delta.prefix", 0},
+        {"find_delta.middle", file_size / 2},
+        {"find_delta.suffix", file_size - 1},
+    };
+    for (const auto& c : cases) {
+        if (!name_selected(options, c.first)) {
+            continue;
+        }
+        std::vector<uint8_t> new_data = old_data;
+        new_data[c.second] ^= 0xFF;
+        size_t delta_start = 0;
+        size_t delta_size = 0;
+        auto samples = measure(config.iterations, [](size_t) {},
+            [&](size_t) {
+                Internals::find_delta(fs, old_data.data(), new_data.data(),
+                                      old_data.size(), new_data.size(), delta_start, delta_size);
+            });
+        reporter.report(make_result(fs, c.first, file_size, 0, samples, file_size));
+    }
+}
+
+void bench_allocate(const Options& options, Reporter& reporter, const Config& config,
+                    size_t image_size) {
+    size_t allocations = config.iterations * 16;
+
+    if (name_selected(options, "allocate_block.contiguous")) {
+        TempImage image(options, "alloc");
+        COWFileSystem fs(image.path(), image_size, TieringOptions(), arena_options(options));
+        size_t block = 0;
+        auto samples = measure(std::min(allocations, Internals::total_blocks(fs) - 1), [](size_t) {},
+                               [&](size_t) { Internals::allocate_block(fs, block); });
+        reporter.report(make_result(fs, "allocate_block.contiguous", 0, image_size, samples, BLOCK_SIZE));
+    }
+
+    if (name_selected(options, "allocate_block.fragmented")) {
+        // Huecos libres de 2 a 8 bloques separados por un bloque ocupado: ningun
+        // hueco encaja exactamente, asi que best-fit recorre toda la lista
+        TempImage image(options, "alloc");
+        COWFileSystem fs(image.path(), image_size, TieringOptions(), arena_options(options));
+        std::mt19937_64 rng(7);
+        std::vector<std::pair<size_t, size_t>> extents;
+        size_t total = Internals::total_blocks(fs);
+        for (size_t start = 1; start < total;) {
+            size_t length = std::min<size_t>(2 + rng() % 7, total - start);
+            extents.emplace_back(start, length);
+            start += length + 1;
+        }
+        Internals::set_free_extents(fs, extents);
+        size_t block = 0;
+        auto samples = measure(std::min(allocations, total / 2), [](size_t) {},
+                               [&](size_t) { Internals::allocate_block(fs, block); });
+        Result result = make_result(fs, "allocate_block.fragmented", 0, image_size, samples, BLOCK_SIZE);
+        result.metrics.emplace_back("free_extents", static_cast<double>(extents.size()));
+        reporter.report(result);
+    }
+}
+
+void bench_rollback_and_gc(const Options& options, Reporter& reporter, const Config& config,
+                           size_t image_size, size_t file_size) {
+    // Espacio para todas las versiones: cada una ocupa a lo sumo file_size
+    if ((config.versions + 1) * (file_size + BLOCK_SIZE) >= image_size) {
+        return;
+    }
+    Fixture fixture(options, image_size, file_size, 8);
+    if (!fixture.ok()) {
+        return;
+    }
+    COWFileSystem& fs = *fixture.fs;
+
+    auto build_versions = [&]() {
+        fs.rollback_to_version(fixture.fd, 1);
+        fs.garbage_collect();
+        std::vector<uint8_t> current = fixture.content;
+        for (size_t v = 1; v < config.versions; ++v) {
+            current[(v * 7919) % current.size()] ^= 0xFF;
+            fs.write(fixture.fd, current.data(), current.size());
+        }
+    };
+
+    size_t iterations = std::max<size_t>(1, config.iterations / 4);
+
+    if (name_selected(options, "rollback_to_version")) {
+        auto samples = measure(iterations, [&](size_t) { build_versions(); },
+                               [&](size_t) { fs.rollback_to_version(fixture.fd, 1); });
+        Result result = make_result(fs, "rollback_to_version", file_size, image_size, samples, 0);
+        result.params.emplace_back("versions", config.versions);
+        reporter.report(result);
+    }
+
+    if (name_selected(options, "garbage_collect")) {
+        auto samples = measure(iterations,
+            [&](size_t) {
+                build_versions();
+                fs.rollback_to_version(fixture.fd, 1);
+            },
+            [&](size_t) { fs.garbage_collect(); });
+        Result result = make_result(fs, "garbage_collect", file_size, image_size, samples, 0);
+        result.params.emplace_back("versions", config.versions);
+        reporter.report(result);
+    }
+}
+
+// Regresiones del nucleo que harian medir rutas de error a los benchmarks:
+// lectura de una version con delta_start > 0, bloque 0 reservado, lista
+// libre sin rangos solapados tras garbage_collect() y escritura que trunca.
+// Devuelve los fallos encontrados
+std::vector<std::string> self_check(const Options& options) {
+    std::vector<std::string> failures;
+    auto expect = [&failures](bool condition, const std::string& message) {
+        if (!condition) {
+            failures.push_back(message);
+        }
+    };
+
+    {
+        TempImage image(options, "check");
+        COWFileSystem fs(image.path(), 1 << 20, TieringOptions(), arena_options(options));
+        fd_t fd = fs.create("check_file");
+        std::vector<uint8_t> content = random_bytes(3 * BLOCK_SIZE, 9);
+        fs.write(fd, content.data(), content.size());
+
+        // Solo cambia el ultimo bloque: la version 2 guarda [delta_start, size)
+        // y el prefijo se lee de la version 1
+        content.back() ^= 0xFF;
+        fs.write(fd, content.data(), content.size());
+        std::vector<VersionInfo> history = fs.get_version_history(fd);
+        expect(history.size() == 2 && history.back().delta_start > 0,
+               "an edit of the last block did not store a delta after offset 0");
+        std::vector<uint8_t> buffer(content.size());
+        Internals::seek(fs, fd, 0);
+        expect(fs.read(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(content.size()) &&
+               buffer == content, "reading a version with delta_start > 0 returned the wrong bytes");
+
+        // Un contenido que es prefijo del anterior sigue siendo un cambio
+        content.resize(BLOCK_SIZE + 100);
+        fs.write(fd, content.data(), content.size());
+        expect(fs.get_version_count(fd) == 3 && fs.get_file_size(fd) == content.size(),
+               "a truncating write did not create a version");
+
+        // Dos pasadas: la segunda no debe volver a anadir rangos ya libres
+        fs.rollback_to_version(fd, 1);
+        fs.garbage_collect();
+        fs.garbage_collect();
+        std::vector<std::pair<size_t, size_t>> extents = Internals::free_extents(fs);
+        std::sort(extents.begin(), extents.end());
+        bool disjoint = true;
+        for (size_t i = 0; i < extents.size(); ++i) {
+            disjoint = disjoint && extents[i].first > 0 &&
+                       extents[i].first + extents[i].second <= Internals::total_blocks(fs) &&
+                       (i == 0 || extents[i - 1].first + extents[i - 1].second <= extents[i].first);
+        }
+        expect(disjoint, "the free list has overlapping extents after garbage_collect()");
+        fs.close(fd);
+    }
+
+    {
+        // next_block == 0 termina las cadenas: el bloque 0 nunca se asigna
+        TempImage image(options, "check");
+        COWFileSystem fs(image.path(), 64 * BLOCK_SIZE, TieringOptions(), arena_options(options));
+        size_t block = 0;
+        size_t allocated = 0;
+        bool allocated_zero = false;
+        while (Internals::allocate_block(fs, block)) {
+            allocated_zero = allocated_zero || block == 0;
+            allocated++;
+        }
+        expect(!allocated_zero && allocated == Internals::total_blocks(fs) - 1,
+               "block 0 was allocated, or not all other blocks could be");
+    }
+    return failures;
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_core [options]\n"
+              << "  --file-sizes=LIST   file sizes (default 4K,64K,1M)\n"
+              << "  --image-sizes=LIST  image sizes (default 16M,64M)\n"
+              << "  --iterations=N      samples per benchmark (default 50)\n"
+              << "  --versions=N        versions for rollback/gc (default 16)\n"
+              << "  --chunk=SIZE        read size for read.sequential (default 64K)\n"
+              << "  --filter=TEXT       only run benchmarks whose name contains TEXT\n"
+              << "  --format=json|text  output format (default json, one object per line)\n"
+              << "  --dir=PATH          directory for temporary images (default .)\n"
+              << "  --huge-pages=MODE   none, transparent or explicit huge pages for the block arena\n"
+              << "  --prefault          commit and fault in the whole block arena up front\n"
+              << "  --mlock             lock the block arena in memory\n"
+              << "  --verbose           keep library logging enabled\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.iterations = std::max<size_t>(1, options.get_size("iterations", 50));
+    config.versions = std::max<size_t>(2, options.get_size("versions", 16));
+    config.chunk = std::max<size_t>(1, options.get_size("chunk", 64 * 1024));
+
+    std::vector<size_t> file_sizes = options.get_sizes("file-sizes", {4096, 64 * 1024, 1024 * 1024});
+    std::vector<size_t> image_sizes = options.get_sizes("image-sizes", {16 * 1024 * 1024, 64 * 1024 * 1024});
+
+    Reporter reporter(options);
+    try {
+        // Valida --huge-pages, --prefault y --mlock antes de medir nada
+        arena_options(options);
+        std::vector<std::string> failures = self_check(options);
+        if (!failures.empty()) {
+            for (const auto& failure : failures) {
+                std::cerr << "Self-check failed: " << failure << std::endl;
+            }
+            return 1;
+        }
+        for (size_t file_size : file_sizes) {
+            if (file_size > 0 && !image_sizes.empty()) {
+                bench_find_delta(options, reporter, config, image_sizes.front(), file_size);
+            }
+        }
+        for (size_t image_size : image_sizes) {
+            bench_allocate(options, reporter, config, image_size);
+            for (size_t file_size : file_sizes) {
+                // Se necesita espacio para varias versiones del archivo
+                if (file_size == 0 || file_size * 4 > image_size) {
+                    continue;
+                }
+                bench_read(options, reporter, config, image_size, file_size);
+                bench_write(options, reporter, config, image_size, file_size);
+                bench_rollback_and_gc(options, reporter, config, image_size, file_size);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
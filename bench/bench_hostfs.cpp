@@ -0,0 +1,387 @@
+// Comparacion con el sistema de archivos del host: la misma carga (escribir
+// N versiones, leer la version actual, leer una version antigua, rollback y
+// persistir) sobre COWFileSystem y sobre una implementacion ingenua que
+// guarda una copia completa por version en el sistema de archivos del host
+// (un directorio por archivo, un archivo por version).
+//
+// Cada escritura cambia edit-size bytes en una posicion aleatoria, sin
+// cambiar el tamano del archivo.
+//
+// Uso: bench_hostfs [--files=16] [--versions=32] [--file-size=64K]
+//                   [--edit-size=4K] [--reads=200] [--fsync]
+//                   [--format=json|text] [--dir=.]
+
+#include "bench_common.hpp"
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "hostfs";
+
+struct Config {
+    size_t files;
+    size_t versions;
+    size_t file_size;
+    size_t edit_size;
+    size_t reads;
+    bool fsync;
+};
+
+class Backend {
+public:
+    virtual ~Backend() = default;
+    virtual const char* name() const = 0;
+    virtual bool create(size_t file) = 0;
+    virtual bool write_version(size_t file, const std::vector<uint8_t>& content) = 0;
+    virtual bool read_head(size_t file, std::vector<uint8_t>& out) = 0;
+    // version empieza en 1
+    virtual bool read_version(size_t file, size_t version, std::vector<uint8_t>& out) = 0;
+    virtual bool rollback(size_t file, size_t version) = 0;
+    virtual void persist() = 0;
+    virtual size_t physical_bytes() = 0;
+};
+
+std::string file_name(size_t file) {
+    return "host_" + std::to_string(file);
+}
+
+class CowBackend : public Backend {
+public:
+    CowBackend(const Options& options, size_t image_size)
+        : image(options, "hostfs"), fs(new COWFileSystem(image.path(), image_size)) {}
+
+    const char* name() const override { return "cowfs"; }
+
+    bool create(size_t file) override {
+        fd_t fd = fs->create(file_name(file));
+        return fd >= 0 && fs->close(fd) == 0;
+    }
+
+    bool write_version(size_t file, const std::vector<uint8_t>& content) override {
+        fd_t fd = fs->open(file_name(file), FileMode::WRITE);
+        bool ok = fs->write(fd, content.data(), content.size()) == static_cast<ssize_t>(content.size());
+        fs->close(fd);
+        return ok;
+    }
+
+    bool read_head(size_t file, std::vector<uint8_t>& out) override {
+        fd_t fd = fs->open(file_name(file), FileMode::READ);
+        bool ok = fs->read(fd, out.data(), out.size()) >= 0;
+        fs->close(fd);
+        return ok;
+    }
+
+    bool read_version(size_t file, size_t version, std::vector<uint8_t>& out) override {
+        fd_t fd = fs->open(file_name(file), FileMode::READ);
+        size_t size = out.size();
+        bool ok = Internals::read_version_data(*fs, fd, version, out.data(), size);
+        fs->close(fd);
+        return ok;
+    }
+
+    bool rollback(size_t file, size_t version) override {
+        fd_t fd = fs->open(file_name(file), FileMode::WRITE);
+        bool ok = fs->rollback_to_version(fd, version);
+        fs->close(fd);
+        return ok;
+    }
+
+    // El destructor escribe la imagen completa en disco
+    void persist() override { fs.reset(); }
+
+    size_t physical_bytes() override { return fs ? fs->get_total_memory_usage() : 0; }
+
+private:
+    TempImage image;
+    std::unique_ptr<COWFileSystem> fs;
+};
+
+// Una copia completa por version: <dir>/host_<n>/v<version>
+class HostBackend : public Backend {
+public:
+    HostBackend(const Options& options, size_t files, bool sync_writes)
+        : root(options.get_string("dir", ".") + "/cowfs_bench_hostfs_" + std::to_string(::getpid())),
+          versions(files, 0), sync_writes(sync_writes) {
+        std::filesystem::remove_all(root);
+        std::filesystem::create_directories(root);
+    }
+
+    ~HostBackend() override {
+        std::error_code ignored;
+        std::filesystem::remove_all(root, ignored);
+    }
+
+    const char* name() const override { return "hostfs"; }
+
+    bool create(size_t file) override {
+        return ::mkdir(file_dir(file).c_str(), 0755) == 0;
+    }
+
+    bool write_version(size_t file, const std::vector<uint8_t>& content) override {
+        std::string path = version_path(file, versions[file] + 1);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = write_all(fd, content.data(), content.size()) && (!sync_writes || ::fsync(fd) == 0);
+        ::close(fd);
+        if (ok) {
+            versions[file]++;
+        }
+        return ok;
+    }
+
+    bool read_head(size_t file, std::vector<uint8_t>& out) override {
+        return read_version(file, versions[file], out);
+    }
+
+    bool read_version(size_t file, size_t version, std::vector<uint8_t>& out) override {
+        int fd = ::open(version_path(file, version).c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        ssize_t bytes = ::read(fd, out.data(), out.size());
+        ::close(fd);
+        return bytes >= 0;
+    }
+
+    bool rollback(size_t file, size_t version) override {
+        for (size_t v = versions[file]; v > version; --v) {
+            if (::unlink(version_path(file, v).c_str()) != 0) {
+                return false;
+            }
+        }
+        versions[file] = std::min(versions[file], version);
+        return true;
+    }
+
+    void persist() override {
+        for (size_t file = 0; file < versions.size(); ++file) {
+            for (size_t v = 1; v <= versions[file]; ++v) {
+                sync_path(version_path(file, v), O_RDONLY);
+            }
+            sync_path(file_dir(file), O_RDONLY | O_DIRECTORY);
+        }
+        sync_path(root, O_RDONLY | O_DIRECTORY);
+    }
+
+    // Bloques realmente asignados (st_blocks), no el tamano logico
+    size_t physical_bytes() override {
+        size_t bytes = 0;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+            struct stat st;
+            if (entry.is_regular_file() && ::stat(entry.path().c_str(), &st) == 0) {
+                bytes += static_cast<size_t>(st.st_blocks) * 512;
+            }
+        }
+        return bytes;
+    }
+
+private:
+    std::string root;
+    std::vector<size_t> versions;
+    bool sync_writes;
+
+    std::string file_dir(size_t file) const {
+        return root + "/" + file_name(file);
+    }
+
+    std::string version_path(size_t file, size_t version) const {
+        return file_dir(file) + "/v" + std::to_string(version);
+    }
+
+    static bool write_all(int fd, const uint8_t* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static void sync_path(const std::string& path, int flags) {
+        int fd = ::open(path.c_str(), flags);
+        if (fd >= 0) {
+            ::fsync(fd);
+            ::close(fd);
+        }
+    }
+};
+
+void report_phase(Reporter& reporter, const Config& config, const Backend& backend,
+                  const std::string& op, const std::vector<double>& samples, size_t bytes_per_op) {
+    Result result;
+    result.suite = SUITE;
+    result.name = op + "." + backend.name();
+    result.params.emplace_back("files", config.files);
+    result.params.emplace_back("versions", config.versions);
+    result.params.emplace_back("file_size", config.file_size);
+    result.summary = summarize(samples);
+    result.bytes_per_op = bytes_per_op;
+    double total_ns = 0;
+    for (double sample : samples) {
+        total_ns += sample;
+    }
+    result.metrics.emplace_back("throughput_ops_per_sec",
+                                total_ns > 0 ? static_cast<double>(samples.size()) * 1e9 / total_ns : 0.0);
+    reporter.report(result);
+}
+
+// Ejecuta la carga completa; la semilla fija hace que ambos backends reciban
+// exactamente las mismas operaciones
+void run_backend(const Options& options, Reporter& reporter, const Config& config, Backend& backend) {
+    std::mt19937_64 rng(1);
+    std::vector<std::vector<uint8_t>> contents(config.files);
+    std::vector<uint8_t> buffer(config.file_size);
+    std::vector<double> samples;
+
+    for (size_t f = 0; f < config.files; ++f) {
+        if (!backend.create(f)) {
+            throw std::runtime_error(std::string("create failed on ") + backend.name());
+        }
+        contents[f] = random_bytes(config.file_size, f + 1);
+    }
+
+    // write: version v de todos los archivos antes de la v + 1. Cada fase
+    // empieza con los contadores a cero aunque la anterior no se informe
+    PerfCounters& perf = perf_counters();
+    perf.reset();
+    for (size_t v = 1; v <= config.versions; ++v) {
+        for (size_t f = 0; f < config.files; ++f) {
+            std::vector<uint8_t>& content = contents[f];
+            if (v > 1) {
+                size_t length = std::min(config.edit_size, content.size());
+                size_t offset = rng() % (content.size() - length + 1);
+                for (size_t i = 0; i < length; ++i) {
+                    content[offset + i] = static_cast<uint8_t>(rng());
+                }
+            }
+            bool ok = true;
+            samples.push_back(time_ns(perf, [&]() { ok = backend.write_version(f, content); }));
+            if (!ok) {
+                throw std::runtime_error(std::string("write failed on ") + backend.name());
+            }
+        }
+    }
+    if (name_selected(options, "write_version")) {
+        report_phase(reporter, config, backend, "write_version", samples, config.file_size);
+    }
+
+    // Espacio tras escribir todas las versiones
+    size_t physical = backend.physical_bytes();
+
+    samples.clear();
+    perf.reset();
+    for (size_t i = 0; i < config.reads; ++i) {
+        size_t f = rng() % config.files;
+        samples.push_back(time_ns(perf, [&]() { backend.read_head(f, buffer); }));
+    }
+    if (name_selected(options, "read_head")) {
+        report_phase(reporter, config, backend, "read_head", samples, config.file_size);
+    }
+
+    samples.clear();
+    perf.reset();
+    for (size_t i = 0; i < config.reads && config.versions > 1; ++i) {
+        size_t f = rng() % config.files;
+        size_t version = 1 + rng() % (config.versions - 1);
+        samples.push_back(time_ns(perf, [&]() { backend.read_version(f, version, buffer); }));
+    }
+    if (!samples.empty() && name_selected(options, "read_old_version")) {
+        report_phase(reporter, config, backend, "read_old_version", samples, config.file_size);
+    }
+
+    samples.clear();
+    perf.reset();
+    size_t target = std::max<size_t>(1, config.versions / 2);
+    for (size_t f = 0; f < config.files; ++f) {
+        samples.push_back(time_ns(perf, [&]() { backend.rollback(f, target); }));
+    }
+    if (name_selected(options, "rollback")) {
+        report_phase(reporter, config, backend, "rollback", samples, 0);
+    }
+
+    perf.reset();
+    samples.assign(1, time_ns(perf, [&]() { backend.persist(); }));
+    if (name_selected(options, "persist")) {
+        report_phase(reporter, config, backend, "persist", samples, 0);
+    }
+
+    if (name_selected(options, "space")) {
+        Result result;
+        result.suite = SUITE;
+        result.name = std::string("space.") + backend.name();
+        result.timed = false;
+        result.params.emplace_back("files", config.files);
+        result.params.emplace_back("versions", config.versions);
+        result.params.emplace_back("file_size", config.file_size);
+        double head_bytes = static_cast<double>(config.files * config.file_size);
+        result.metrics.emplace_back("head_bytes", head_bytes);
+        result.metrics.emplace_back("all_versions_bytes", head_bytes * static_cast<double>(config.versions));
+        result.metrics.emplace_back("physical_bytes", static_cast<double>(physical));
+        result.metrics.emplace_back("physical_per_head_byte", static_cast<double>(physical) / head_bytes);
+        reporter.report(result);
+    }
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_hostfs [options]\n"
+              << "  --files=N                 number of files, at most " << MAX_FILES << " (default 16)\n"
+              << "  --versions=N              versions written to each file (default 32)\n"
+              << "  --file-size=SIZE          size of each file (default 64K)\n"
+              << "  --edit-size=SIZE          bytes changed by each new version (default 4K)\n"
+              << "  --reads=N                 head and old-version reads (default 200)\n"
+              << "  --fsync                   fsync every host version file as it is written\n"
+              << "  --filter=TEXT             only report results whose name contains TEXT\n"
+              << "  --format=json|text        output format (default json)\n"
+              << "  --dir=PATH                directory for the image and host files (default .)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.files = std::min<size_t>(std::max<size_t>(1, options.get_size("files", 16)), MAX_FILES);
+    config.versions = std::max<size_t>(1, options.get_size("versions", 32));
+    config.file_size = std::max<size_t>(1, options.get_size("file-size", 64 * 1024));
+    config.edit_size = std::max<size_t>(1, options.get_size("edit-size", 4 * 1024));
+    config.reads = options.get_size("reads", 200);
+    config.fsync = options.has("fsync");
+
+    // Peor caso de cowfs: cada version guarda desde la edicion hasta el final
+    size_t blocks_per_version = (config.file_size + BLOCK_SIZE - 1) / BLOCK_SIZE + 1;
+    size_t image_size = (config.files * config.versions * blocks_per_version + 64) * BLOCK_SIZE;
+
+    Reporter reporter(options);
+    try {
+        {
+            CowBackend cow(options, image_size);
+            run_backend(options, reporter, config, cow);
+        }
+        {
+            HostBackend host(options, config.files, config.fsync);
+            run_backend(options, reporter, config, host);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Benchmark de operaciones de espacio de nombres segun el numero de inodos
+// ocupados: create(), open(), find_inode(), list_files(), get_file_status()
+// y MetadataManager::save_metadata().
+//
+// Uso: bench_metadata [--inode-counts=16,64,256,1024] [--samples=200]
+//                     [--versions-per-file=2] [--file-size=1K]
+//                     [--filter=open] [--format=json|text] [--dir=.]
+
+#include "bench_common.hpp"
+#include "cowfs_metadata.hpp"
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "metadata";
+
+struct Config {
+    size_t samples;
+    size_t versions_per_file;
+    size_t file_size;
+};
+
+std::string file_name(size_t index) {
+    return "meta_file_" + std::to_string(index) + ".dat";
+}
+
+// Escribe el numero de versiones pedido en un archivo ya creado
+void write_versions(COWFileSystem& fs, size_t index, const Config& config) {
+    fd_t fd = fs.open(file_name(index), FileMode::WRITE);
+    std::vector<uint8_t> content = random_bytes(config.file_size, index + 1);
+    for (size_t v = 0; v < config.versions_per_file && !content.empty(); ++v) {
+        content[(v * 131) % content.size()] ^= 0xFF;
+        fs.write(fd, content.data(), content.size());
+    }
+    fs.close(fd);
+}
+
+size_t image_size_for(size_t inode_count, const Config& config) {
+    size_t blocks_per_file = (config.file_size + BLOCK_SIZE - 1) / BLOCK_SIZE + 1;
+    size_t bytes = inode_count * blocks_per_file * (config.versions_per_file + 1) * BLOCK_SIZE;
+    return std::max<size_t>(bytes + 64 * BLOCK_SIZE, 4 * 1024 * 1024);
+}
+
+void report(Reporter& reporter, const std::string& name, size_t inode_count,
+            const std::vector<double>& samples) {
+    Result result;
+    result.suite = SUITE;
+    result.name = name;
+    result.params.emplace_back("inodes", inode_count);
+    result.summary = summarize(samples);
+    reporter.report(result);
+}
+
+void bench_inode_count(const Options& options, Reporter& reporter, const Config& config,
+                       size_t inode_count) {
+    TempImage image(options, "metadata");
+    COWFileSystem fs(image.path(), image_size_for(inode_count, config));
+    std::mt19937_64 rng(inode_count);
+
+    // create: se llena la tabla hasta inode_count - k sin medir y se miden
+    // las k ultimas creaciones
+    size_t measured_creates = std::min(config.samples, inode_count);
+    size_t prefilled = inode_count - measured_creates;
+    std::vector<double> create_samples;
+    for (size_t i = 0; i < inode_count; ++i) {
+        fd_t fd = -1;
+        double elapsed = time_ns([&]() { fd = fs.create(file_name(i)); });
+        if (i >= prefilled) {
+            create_samples.push_back(elapsed);
+        }
+        fs.close(fd);
+        write_versions(fs, i, config);
+    }
+    if (name_selected(options, "create")) {
+        report(reporter, "create", inode_count, create_samples);
+    }
+
+    if (name_selected(options, "open.hit")) {
+        fd_t fd = -1;
+        auto samples = measure(config.samples,
+            [&](size_t) { fs.close(fd); },
+            [&](size_t) { fd = fs.open(file_name(rng() % inode_count), FileMode::READ); });
+        fs.close(fd);
+        report(reporter, "open.hit", inode_count, samples);
+    }
+
+    if (name_selected(options, "open.miss")) {
+        auto samples = measure(config.samples, [](size_t) {},
+            [&](size_t) { fs.open("missing_file", FileMode::READ); });
+        report(reporter, "open.miss", inode_count, samples);
+    }
+
+    if (name_selected(options, "find_inode.hit")) {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < config.samples; ++i) {
+            names.push_back(file_name(rng() % inode_count));
+        }
+        auto samples = measure(config.samples, [](size_t) {},
+            [&](size_t i) { Internals::find_inode(fs, names[i]); });
+        report(reporter, "find_inode.hit", inode_count, samples);
+    }
+
+    if (name_selected(options, "find_inode.miss")) {
+        auto samples = measure(config.samples, [](size_t) {},
+            [&](size_t) { Internals::find_inode(fs, "missing_file"); });
+        report(reporter, "find_inode.miss", inode_count, samples);
+    }
+
+    if (name_selected(options, "list_files")) {
+        std::vector<std::string> files;
+        auto samples = measure(config.samples, [](size_t) {},
+            [&](size_t) { fs.list_files(files); });
+        report(reporter, "list_files", inode_count, samples);
+    }
+
+    if (name_selected(options, "get_file_status")) {
+        fd_t fd = -1;
+        auto samples = measure(config.samples,
+            [&](size_t) {
+                fs.close(fd);
+                fd = fs.open(file_name(rng() % inode_count), FileMode::READ);
+            },
+            [&](size_t) { fs.get_file_status(fd); });
+        fs.close(fd);
+        report(reporter, "get_file_status", inode_count, samples);
+    }
+
+    if (name_selected(options, "save_metadata")) {
+        // save_metadata escribe metadata_<etiqueta>.json en el directorio actual
+        const std::string label = "bench_metadata";
+        auto samples = measure(std::max<size_t>(1, config.samples / 20), [](size_t) {},
+            [&](size_t) { MetadataManager::save_metadata(fs, label); });
+        std::remove(("metadata_" + label + ".json").c_str());
+        report(reporter, "save_metadata", inode_count, samples);
+    }
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_metadata [options]\n"
+              << "  --inode-counts=LIST       used inodes per run (default 16,64,256,1024)\n"
+              << "  --samples=N               samples per operation (default 200)\n"
+              << "  --versions-per-file=N     versions written to each file (default 2)\n"
+              << "  --file-size=SIZE          content size of each file (default 1K)\n"
+              << "  --filter=TEXT             only run operations whose name contains TEXT\n"
+              << "  --format=json|text        output format (default json)\n"
+              << "  --dir=PATH                directory for temporary images (default .)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.samples = std::max<size_t>(1, options.get_size("samples", 200));
+    config.versions_per_file = options.get_size("versions-per-file", 2);
+    config.file_size = options.get_size("file-size", 1024);
+
+    Reporter reporter(options);
+    try {
+        for (size_t inode_count : options.get_sizes("inode-counts", {16, 64, 256, MAX_FILES})) {
+            if (inode_count == 0 || inode_count > MAX_FILES) {
+                std::cerr << "Skipping inode count " << inode_count
+                          << " (must be between 1 and " << MAX_FILES << ")" << std::endl;
+                continue;
+            }
+            bench_inode_count(options, reporter, config, inode_count);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
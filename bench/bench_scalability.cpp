@@ -0,0 +1,281 @@
+// Harness de escalabilidad con hilos: carga mixta de read/write/rollback con
+// 1..N hilos sobre conjuntos de archivos disjuntos o compartidos.
+//
+// COWFileSystem no es thread-safe, asi que hoy hay dos modos:
+//   global  - una sola imagen protegida por un mutex global (linea base)
+//   sharded - una imagen por shard, cada una con su mutex; los archivos se
+//             reparten entre shards por hash del nombre
+//
+// Uso: bench_scalability [--threads=1,2,4,8] [--modes=global,sharded]
+//                        [--file-sets=disjoint,shared] [--files=64]
+//                        [--file-size=16K] [--duration-ms=1000]
+//                        [--read-pct=70] [--write-pct=25] [--rollback-pct=5]
+//                        [--format=json|text] [--dir=.]
+
+#include "bench_common.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "scalability";
+
+enum OpKind { OP_READ = 0, OP_WRITE, OP_ROLLBACK, OP_KIND_COUNT };
+const char* const OP_NAMES[OP_KIND_COUNT] = {"read", "write", "rollback"};
+
+// Numero de versiones a partir del cual un archivo vuelve a la version 1
+constexpr size_t MAX_VERSIONS_PER_FILE = 64;
+
+struct Config {
+    size_t files;
+    size_t file_size;
+    size_t duration_ms;
+    unsigned read_pct;
+    unsigned write_pct;
+};
+
+struct Shard {
+    Shard(const Options& options, size_t image_size)
+        : image(options, "scalability"), fs(image.path(), image_size) {}
+
+    TempImage image;
+    COWFileSystem fs;
+    std::mutex mutex;
+};
+
+class Harness {
+public:
+    Harness(const Options& options, const Config& config, size_t shard_count)
+        : config(config) {
+        size_t files_per_shard = (config.files + shard_count - 1) / shard_count;
+        size_t blocks_per_version = (config.file_size + BLOCK_SIZE - 1) / BLOCK_SIZE + 1;
+        // Espacio para el numero maximo de versiones de cada archivo
+        size_t image_size = files_per_shard * blocks_per_version * (MAX_VERSIONS_PER_FILE + 8) *
+                            BLOCK_SIZE + 64 * BLOCK_SIZE;
+        for (size_t s = 0; s < shard_count; ++s) {
+            shards.emplace_back(new Shard(options, image_size));
+        }
+        for (size_t f = 0; f < config.files; ++f) {
+            Shard& shard = shard_for(f);
+            fd_t fd = shard.fs.create(file_name(f));
+            std::vector<uint8_t> content = random_bytes(config.file_size, f + 1);
+            shard.fs.write(fd, content.data(), content.size());
+            shard.fs.close(fd);
+        }
+    }
+
+    static std::string file_name(size_t index) {
+        return "scale_" + std::to_string(index);
+    }
+
+    Shard& shard_for(size_t file) {
+        return *shards[std::hash<std::string>()(file_name(file)) % shards.size()];
+    }
+
+    // Ejecuta una operacion sobre el archivo bajo el mutex de su shard
+    void run_op(OpKind kind, size_t file, std::vector<uint8_t>& buffer, std::mt19937_64& rng) {
+        Shard& shard = shard_for(file);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        COWFileSystem& fs = shard.fs;
+        const std::string name = file_name(file);
+
+        if (kind == OP_READ) {
+            fd_t fd = fs.open(name, FileMode::READ);
+            fs.read(fd, buffer.data(), buffer.size());
+            fs.close(fd);
+            return;
+        }
+
+        fd_t fd = fs.open(name, FileMode::WRITE);
+        size_t versions = fs.get_version_count(fd);
+        if (kind == OP_ROLLBACK || versions >= MAX_VERSIONS_PER_FILE) {
+            size_t target = kind == OP_ROLLBACK && versions > 2 ? versions - 2 : 1;
+            fs.rollback_to_version(fd, target);
+            fs.close(fd);
+            return;
+        }
+
+        // Escritura: se lee el contenido actual y se modifica una zona pequena
+        size_t size = fs.read(fd, buffer.data(), buffer.size()) > 0 ? fs.get_file_size(fd) : 0;
+        if (size == 0) {
+            size = config.file_size;
+        }
+        size_t offset = rng() % size;
+        size_t length = std::min<size_t>(64, size - offset);
+        for (size_t i = 0; i < length; ++i) {
+            buffer[offset + i] = static_cast<uint8_t>(rng());
+        }
+        if (fs.write(fd, buffer.data(), size) < 0) {
+            // Sin espacio: se recupera el de las versiones antiguas
+            fs.rollback_to_version(fd, 1);
+            fs.garbage_collect();
+        }
+        fs.close(fd);
+    }
+
+private:
+    const Config& config;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+struct ThreadResult {
+    std::vector<double> latencies[OP_KIND_COUNT];
+    uint64_t operations = 0;
+};
+
+void run_config(const Options& options, Reporter& reporter, const Config& config,
+                const std::string& mode, const std::string& file_set, size_t threads) {
+    size_t shard_count = mode == "sharded" ? threads : 1;
+    Harness harness(options, config, shard_count);
+
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::vector<ThreadResult> results(threads);
+    std::vector<std::thread> workers;
+    // Cada hilo cuenta con su propio grupo y lo suma al terminar
+    std::mutex counters_mutex;
+    perf_counters().reset();
+
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::mt19937_64 rng(t + 1);
+            std::vector<uint8_t> buffer(config.file_size);
+            // Archivos disjuntos: cada hilo trabaja en su propio rango
+            size_t first = 0;
+            size_t count = config.files;
+            if (file_set == "disjoint") {
+                size_t per_thread = std::max<size_t>(1, config.files / threads);
+                first = std::min(t * per_thread, config.files - 1);
+                count = std::min(per_thread, config.files - first);
+            }
+            PerfCounters counters;
+            open_like_main(counters);
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            ThreadResult& result = results[t];
+            while (!stop.load(std::memory_order_relaxed)) {
+                unsigned dice = static_cast<unsigned>(rng() % 100);
+                OpKind kind = dice < config.read_pct ? OP_READ
+                            : dice < config.read_pct + config.write_pct ? OP_WRITE
+                            : OP_ROLLBACK;
+                size_t file = first + rng() % count;
+                result.latencies[kind].push_back(
+                    time_ns(counters, [&]() { harness.run_op(kind, file, buffer, rng); }));
+                result.operations++;
+            }
+            std::lock_guard<std::mutex> lock(counters_mutex);
+            perf_counters().merge(counters);
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(config.duration_ms));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<double> all;
+    std::vector<double> per_op[OP_KIND_COUNT];
+    uint64_t operations = 0;
+    for (auto& result : results) {
+        operations += result.operations;
+        for (int k = 0; k < OP_KIND_COUNT; ++k) {
+            per_op[k].insert(per_op[k].end(), result.latencies[k].begin(), result.latencies[k].end());
+            all.insert(all.end(), result.latencies[k].begin(), result.latencies[k].end());
+        }
+    }
+
+    Result result;
+    result.suite = SUITE;
+    result.name = "mixed." + mode + "." + file_set;
+    result.params.emplace_back("threads", threads);
+    result.params.emplace_back("files", config.files);
+    result.params.emplace_back("file_size", config.file_size);
+    result.summary = summarize(all);
+    result.metrics.emplace_back("throughput_ops_per_sec", static_cast<double>(operations) / elapsed_s);
+    for (int k = 0; k < OP_KIND_COUNT; ++k) {
+        Summary s = summarize(per_op[k]);
+        std::string prefix = OP_NAMES[k];
+        result.metrics.emplace_back(prefix + "_ops", static_cast<double>(s.samples));
+        result.metrics.emplace_back(prefix + "_p50_ns", s.median_ns);
+        result.metrics.emplace_back(prefix + "_p99_ns", s.p99_ns);
+    }
+    reporter.report(result);
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_scalability [options]\n"
+              << "  --threads=LIST            thread counts (default 1,2,4,... up to 2x cores)\n"
+              << "  --modes=LIST              global (one image, global lock) and/or sharded\n"
+              << "  --file-sets=LIST          disjoint (per-thread files) and/or shared\n"
+              << "  --files=N                 number of files (default 64)\n"
+              << "  --file-size=SIZE          initial file size (default 16K)\n"
+              << "  --duration-ms=N           run time per configuration (default 1000)\n"
+              << "  --read-pct/--write-pct/--rollback-pct  operation mix (default 70/25/5)\n"
+              << "  --format=json|text        output format (default json)\n"
+              << "  --dir=PATH                directory for temporary images (default .)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.files = std::max<size_t>(1, options.get_size("files", 64));
+    config.file_size = std::max<size_t>(1, options.get_size("file-size", 16 * 1024));
+    config.duration_ms = std::max<size_t>(1, options.get_size("duration-ms", 1000));
+    config.read_pct = static_cast<unsigned>(options.get_size("read-pct", 70));
+    config.write_pct = static_cast<unsigned>(options.get_size("write-pct", 25));
+    size_t rollback_pct = options.get_size("rollback-pct", 5);
+    if (config.read_pct + config.write_pct + rollback_pct != 100) {
+        std::cerr << "The operation mix must add up to 100" << std::endl;
+        return 1;
+    }
+
+    std::vector<size_t> default_threads;
+    size_t max_threads = 2 * std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t t = 1; t <= max_threads; t *= 2) {
+        default_threads.push_back(t);
+    }
+
+    Reporter reporter(options);
+    try {
+        for (const auto& mode : options.get_strings("modes", "global,sharded")) {
+            if (mode != "global" && mode != "sharded") {
+                std::cerr << "Unknown mode: " << mode << std::endl;
+                continue;
+            }
+            for (const auto& file_set : options.get_strings("file-sets", "disjoint,shared")) {
+                if (file_set != "disjoint" && file_set != "shared") {
+                    std::cerr << "Unknown file set: " << file_set << std::endl;
+                    continue;
+                }
+                for (size_t threads : options.get_sizes("threads", default_threads)) {
+                    if (threads > 0) {
+                        run_config(options, reporter, config, mode, file_set, threads);
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
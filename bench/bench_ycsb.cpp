@@ -0,0 +1,404 @@
+// Generador de carga sintetica al estilo YCSB sobre la API publica: la
+// popularidad de los archivos sigue una distribucion Zipf, la mezcla de
+// read/write/append/rollback y la distribucion de tamanos son configurables,
+// y las ediciones se concentran al principio, en medio, al final o en
+// posiciones aleatorias del archivo.
+//
+// Ademas de la latencia por operacion informa del throughput, de la
+// amplificacion de espacio (bytes ocupados / bytes logicos) y de la longitud
+// de las cadenas de versiones.
+//
+// Uso: bench_ycsb [--files=256] [--operations=20000] [--zipf=0.99]
+//                 [--read-pct=50] [--write-pct=30] [--append-pct=15]
+//                 [--rollback-pct=5] [--file-size=16K]
+//                 [--size-dist=fixed|uniform|lognormal] [--edit-size=64]
+//                 [--localities=prefix,middle,suffix,random]
+//                 [--image-size=SIZE] [--seed=1] [--format=json|text] [--dir=.]
+
+#include "bench_common.hpp"
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "ycsb";
+
+enum OpKind { OP_READ = 0, OP_WRITE, OP_APPEND, OP_ROLLBACK, OP_KIND_COUNT };
+const char* const OP_NAMES[OP_KIND_COUNT] = {"read", "write", "append", "rollback"};
+
+// Limite del tamano de imagen calculado por defecto
+constexpr size_t MAX_DEFAULT_IMAGE_SIZE = size_t(1) << 30;
+
+struct Config {
+    size_t files;
+    size_t operations;
+    double zipf_theta;
+    unsigned pct[OP_KIND_COUNT];
+    size_t file_size;
+    std::string size_dist;
+    size_t edit_size;
+    size_t image_size;
+    uint64_t seed;
+};
+
+// Generador Zipf de Gray et al. ("Quickly generating billion-record
+// synthetic databases"), el mismo que usa YCSB. Devuelve rangos en
+// [0, items) donde 0 es el mas popular; theta = 0 equivale a uniforme.
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(size_t items, double theta)
+        : items(items), theta(theta), zetan(zeta(items, theta)), alpha(1.0 / (1.0 - theta)) {
+        double zeta2 = zeta(2, theta);
+        eta = items > 2 ? (1.0 - std::pow(2.0 / static_cast<double>(items), 1.0 - theta)) /
+                          (1.0 - zeta2 / zetan)
+                        : 0.0;
+    }
+
+    size_t next(std::mt19937_64& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        double uz = u * zetan;
+        if (uz < 1.0 || items < 2) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta)) {
+            return 1;
+        }
+        size_t rank = static_cast<size_t>(static_cast<double>(items) *
+                                          std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(rank, items - 1);
+    }
+
+private:
+    static double zeta(size_t n, double theta) {
+        double sum = 0;
+        for (size_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+    size_t items;
+    double theta;
+    double zetan;
+    double alpha;
+    double eta;
+};
+
+size_t pick_file_size(const Config& config, std::mt19937_64& rng) {
+    size_t mean = config.file_size;
+    if (config.size_dist == "uniform") {
+        return mean / 2 + rng() % (mean + 1);
+    }
+    if (config.size_dist == "lognormal") {
+        // sigma = 1 y mu ajustada para que la media sea file_size
+        std::lognormal_distribution<double> dist(std::log(static_cast<double>(mean)) - 0.5, 1.0);
+        return std::min<size_t>(std::max<size_t>(1, static_cast<size_t>(dist(rng))), 64 * mean);
+    }
+    return mean;
+}
+
+// Posicion de una edicion de length bytes segun el patron de localidad
+size_t edit_offset(const std::string& locality, size_t size, size_t length, std::mt19937_64& rng) {
+    size_t span = size - length;
+    if (locality == "prefix") {
+        return 0;
+    }
+    if (locality == "middle") {
+        return span / 2;
+    }
+    if (locality == "suffix") {
+        return span;
+    }
+    return span == 0 ? 0 : rng() % (span + 1);
+}
+
+class Workload {
+public:
+    Workload(const Options& options, const Config& config, const std::string& locality)
+        : config(config), locality(locality), image(options, "ycsb"),
+          fs(image.path(), config.image_size), zipf(config.files, config.zipf_theta),
+          rng(config.seed), contents(config.files) {
+        open_like_main(op_counters);
+    }
+
+    bool load() {
+        for (size_t f = 0; f < config.files; ++f) {
+            contents[f] = random_bytes(std::max<size_t>(1, pick_file_size(config, rng)), rng());
+            fd_t fd = fs.create(file_name(f));
+            if (fd < 0 || fs.write(fd, contents[f].data(), contents[f].size()) < 0) {
+                return false;
+            }
+            fs.close(fd);
+        }
+        return true;
+    }
+
+    void run(std::vector<double> (&latencies)[OP_KIND_COUNT]) {
+        for (size_t i = 0; i < config.operations; ++i) {
+            unsigned dice = static_cast<unsigned>(rng() % 100);
+            int kind = 0;
+            unsigned bound = config.pct[0];
+            while (kind < OP_KIND_COUNT - 1 && dice >= bound) {
+                bound += config.pct[++kind];
+            }
+            size_t file = zipf.next(rng);
+            double elapsed = 0;
+            op_counters.reset();
+            if (run_op(static_cast<OpKind>(kind), file, elapsed)) {
+                latencies[kind].push_back(elapsed);
+                counters[kind].merge(op_counters);
+            }
+        }
+    }
+
+    // Contadores hardware de las operaciones medidas de un tipo
+    const PerfCounters& kind_counters(int kind) const { return counters[kind]; }
+
+    // Bytes logicos, versiones y profundidad de lectura de cada archivo
+    void collect(Result& result) {
+        size_t logical = 0;
+        std::vector<double> versions;
+        std::vector<double> chains;
+        for (size_t f = 0; f < config.files; ++f) {
+            fd_t fd = fs.open(file_name(f), FileMode::READ);
+            logical += fs.get_file_size(fd);
+            std::vector<VersionInfo> history = fs.get_version_history(fd);
+            fs.close(fd);
+            versions.push_back(static_cast<double>(history.size()));
+            // Una lectura completa recorre las versiones desde la ultima hasta
+            // la mas reciente que empieza en el byte 0
+            size_t chain = 0;
+            for (size_t v = history.size(); v-- > 0;) {
+                chain++;
+                if (history[v].delta_start == 0) {
+                    break;
+                }
+            }
+            chains.push_back(static_cast<double>(chain));
+        }
+        size_t physical = fs.get_total_memory_usage();
+        Summary version_summary = summarize(versions);
+        Summary chain_summary = summarize(chains);
+        result.metrics.emplace_back("logical_bytes", static_cast<double>(logical));
+        result.metrics.emplace_back("physical_bytes", static_cast<double>(physical));
+        result.metrics.emplace_back("space_amplification",
+                                    logical > 0 ? static_cast<double>(physical) / static_cast<double>(logical) : 0.0);
+        result.metrics.emplace_back("versions_mean", version_summary.mean_ns);
+        result.metrics.emplace_back("versions_max", version_summary.max_ns);
+        result.metrics.emplace_back("read_chain_mean", chain_summary.mean_ns);
+        result.metrics.emplace_back("read_chain_max", chain_summary.max_ns);
+        result.metrics.emplace_back("space_recoveries", static_cast<double>(space_recoveries));
+    }
+
+private:
+    static std::string file_name(size_t index) {
+        return "ycsb_" + std::to_string(index);
+    }
+
+    bool run_op(OpKind kind, size_t file, double& elapsed) {
+        const std::string name = file_name(file);
+        std::vector<uint8_t>& content = contents[file];
+
+        if (kind == OP_READ) {
+            buffer.resize(content.size());
+            elapsed = time_ns(op_counters, [&]() {
+                fd_t fd = fs.open(name, FileMode::READ);
+                fs.read(fd, buffer.data(), buffer.size());
+                fs.close(fd);
+            });
+            return true;
+        }
+
+        if (kind == OP_ROLLBACK) {
+            fd_t fd = fs.open(name, FileMode::WRITE);
+            size_t versions = fs.get_version_count(fd);
+            fs.close(fd);
+            if (versions < 2) {
+                return false;
+            }
+            elapsed = time_ns(op_counters, [&]() {
+                fd_t wfd = fs.open(name, FileMode::WRITE);
+                fs.rollback_to_version(wfd, versions - 1);
+                fs.close(wfd);
+            });
+            refresh(file);
+            return true;
+        }
+
+        if (kind == OP_APPEND) {
+            std::vector<uint8_t> tail = random_bytes(config.edit_size, rng());
+            content.insert(content.end(), tail.begin(), tail.end());
+        } else {
+            size_t length = std::min(config.edit_size, content.size());
+            size_t offset = edit_offset(locality, content.size(), length, rng);
+            for (size_t i = 0; i < length; ++i) {
+                content[offset + i] = static_cast<uint8_t>(rng());
+            }
+        }
+
+        ssize_t written = -1;
+        elapsed = time_ns(op_counters, [&]() {
+            fd_t fd = fs.open(name, FileMode::WRITE);
+            written = fs.write(fd, content.data(), content.size());
+            fs.close(fd);
+        });
+        if (written < 0) {
+            // Imagen llena: se descarta el historial del archivo y se recupera
+            // el espacio; la operacion no cuenta
+            fd_t fd = fs.open(name, FileMode::WRITE);
+            fs.rollback_to_version(fd, 1);
+            fs.close(fd);
+            fs.garbage_collect();
+            refresh(file);
+            space_recoveries++;
+            return false;
+        }
+        return true;
+    }
+
+    // Vuelve a leer el contenido actual del archivo (sin medir)
+    void refresh(size_t file) {
+        fd_t fd = fs.open(file_name(file), FileMode::READ);
+        contents[file].resize(fs.get_file_size(fd));
+        if (!contents[file].empty()) {
+            fs.read(fd, contents[file].data(), contents[file].size());
+        }
+        fs.close(fd);
+    }
+
+    const Config& config;
+    const std::string& locality;
+    TempImage image;
+    COWFileSystem fs;
+    ZipfianGenerator zipf;
+    std::mt19937_64 rng;
+    std::vector<std::vector<uint8_t>> contents;
+    std::vector<uint8_t> buffer;
+    size_t space_recoveries = 0;
+    // Grupo de la operacion en curso; solo se suma a su tipo si la
+    // operacion cuenta (una escritura con la imagen llena no)
+    PerfCounters op_counters;
+    PerfCounters counters[OP_KIND_COUNT];
+};
+
+void run_locality(const Options& options, Reporter& reporter, const Config& config,
+                  const std::string& locality) {
+    Workload workload(options, config, locality);
+    if (!workload.load()) {
+        std::cerr << "Image too small to load " << config.files << " files" << std::endl;
+        return;
+    }
+
+    std::vector<double> latencies[OP_KIND_COUNT];
+    double elapsed_ns = time_ns([&]() { workload.run(latencies); });
+
+    auto make_result = [&](const std::string& name) {
+        Result result;
+        result.suite = SUITE;
+        result.name = name;
+        result.params.emplace_back("files", config.files);
+        result.params.emplace_back("file_size", config.file_size);
+        result.params.emplace_back("edit_size", config.edit_size);
+        return result;
+    };
+
+    std::vector<double> all;
+    for (int k = 0; k < OP_KIND_COUNT; ++k) {
+        all.insert(all.end(), latencies[k].begin(), latencies[k].end());
+        if (!latencies[k].empty() && name_selected(options, OP_NAMES[k])) {
+            Result result = make_result(std::string(OP_NAMES[k]) + "." + locality);
+            result.summary = summarize(latencies[k]);
+            perf_counters().reset();
+            perf_counters().merge(workload.kind_counters(k));
+            reporter.report(result);
+        }
+    }
+
+    perf_counters().reset();
+    for (int k = 0; k < OP_KIND_COUNT; ++k) {
+        perf_counters().merge(workload.kind_counters(k));
+    }
+    Result result = make_result("workload." + locality);
+    result.summary = summarize(all);
+    result.metrics.emplace_back("throughput_ops_per_sec",
+                                elapsed_ns > 0 ? static_cast<double>(all.size()) * 1e9 / elapsed_ns : 0.0);
+    workload.collect(result);
+    reporter.report(result);
+}
+
+void print_usage() {
+    std::cout << "Usage: bench_ycsb [options]\n"
+              << "  --files=N                 number of files, at most " << MAX_FILES << " (default 256)\n"
+              << "  --operations=N            operations per run (default 20000)\n"
+              << "  --zipf=THETA              Zipf skew of file popularity, 0 = uniform (default 0.99)\n"
+              << "  --read-pct/--write-pct/--append-pct/--rollback-pct  operation mix (default 50/30/15/5)\n"
+              << "  --file-size=SIZE          mean initial file size (default 16K)\n"
+              << "  --size-dist=NAME          fixed, uniform or lognormal (default lognormal)\n"
+              << "  --edit-size=SIZE          bytes changed by a write or added by an append (default 64)\n"
+              << "  --localities=LIST         prefix, middle, suffix and/or random edits\n"
+              << "  --image-size=SIZE         image size (default: estimated from the workload, max 1G)\n"
+              << "  --seed=N                  random seed (default 1)\n"
+              << "  --filter=TEXT             only report operations whose name contains TEXT\n"
+              << "  --format=json|text        output format (default json)\n"
+              << "  --dir=PATH                directory for temporary images (default .)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    quiet_logging(options);
+
+    Config config;
+    config.files = std::min<size_t>(std::max<size_t>(1, options.get_size("files", 256)), MAX_FILES);
+    config.operations = options.get_size("operations", 20000);
+    config.zipf_theta = options.get_double("zipf", 0.99);
+    config.pct[OP_READ] = static_cast<unsigned>(options.get_size("read-pct", 50));
+    config.pct[OP_WRITE] = static_cast<unsigned>(options.get_size("write-pct", 30));
+    config.pct[OP_APPEND] = static_cast<unsigned>(options.get_size("append-pct", 15));
+    config.pct[OP_ROLLBACK] = static_cast<unsigned>(options.get_size("rollback-pct", 5));
+    config.file_size = std::max<size_t>(1, options.get_size("file-size", 16 * 1024));
+    config.size_dist = options.get_string("size-dist", "lognormal");
+    config.edit_size = std::max<size_t>(1, options.get_size("edit-size", 64));
+    config.seed = options.get_size("seed", 1);
+
+    if (config.pct[OP_READ] + config.pct[OP_WRITE] + config.pct[OP_APPEND] + config.pct[OP_ROLLBACK] != 100) {
+        std::cerr << "The operation mix must add up to 100" << std::endl;
+        return 1;
+    }
+    if (config.zipf_theta < 0.0 || config.zipf_theta >= 1.0) {
+        std::cerr << "--zipf must be in [0, 1)" << std::endl;
+        return 1;
+    }
+    if (config.size_dist != "fixed" && config.size_dist != "uniform" && config.size_dist != "lognormal") {
+        std::cerr << "Unknown size distribution: " << config.size_dist << std::endl;
+        return 1;
+    }
+
+    // En el peor caso (ediciones al principio) cada escritura guarda el
+    // archivo completo; si la imagen se llena se recupera espacio y se cuenta
+    size_t writes = config.operations * (config.pct[OP_WRITE] + config.pct[OP_APPEND]) / 100;
+    size_t estimate = (2 * config.files + writes) * (config.file_size + 2 * BLOCK_SIZE);
+    config.image_size = options.get_size("image-size",
+                                         std::min(std::max<size_t>(estimate, 16u << 20), MAX_DEFAULT_IMAGE_SIZE));
+
+    Reporter reporter(options);
+    try {
+        for (const auto& locality : options.get_strings("localities", "prefix,middle,suffix,random")) {
+            if (locality != "prefix" && locality != "middle" && locality != "suffix" && locality != "random") {
+                std::cerr << "Unknown locality: " << locality << std::endl;
+                continue;
+            }
+            run_locality(options, reporter, config, locality);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
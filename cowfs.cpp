@@ -1,96 +1,332 @@
 #include "cowfs.hpp"
+#include "cowfs_checksum.hpp"
+#include "cowfs_log.hpp"
+#include "cowfs_recorder.hpp"
+#include "cowfs_trace.hpp"
 #include <fstream>
 #include <cstring>
 #include <stdexcept>
 #include <chrono>
+#include <ctime>
 #include <iomanip>
 #include <sstream>
-#include <iostream>
 #include <algorithm>  
+#include <set>
+#include <unistd.h>
 
 namespace cowfs {
 
-COWFileSystem::COWFileSystem(const std::string& disk_path, size_t disk_size)
-    : disk_path(disk_path), disk_size(disk_size), free_blocks_list(nullptr) {
-    std::cout << "Initializing file system with size: " << disk_size << " bytes" << std::endl;
+namespace {
+
+// Formato de la imagen en disco (enteros de 64 bits en orden nativo):
+//   cabecera: magic, version de formato, BLOCK_SIZE, total de bloques, inodos
+//   inodos:   marca de uso y, si estan en uso, nombre, campos e historial
+//   bloques:  next_block, ref_count, is_used, CRC32C y los BLOCK_SIZE bytes
+//             de datos (la version 1 no guarda el CRC)
+const char IMAGE_MAGIC[8] = {'C', 'O', 'W', 'F', 'S', 'I', 'M', 'G'};
+constexpr uint64_t IMAGE_FORMAT_VERSION = 2;
+constexpr size_t IMAGE_IO_BUFFER_SIZE = 1 << 20;
+
+void write_u64(std::ostream& out, uint64_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void write_string(std::ostream& out, const std::string& value) {
+    write_u64(out, value.size());
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+template <typename T>
+bool read_u64(std::istream& in, T& value) {
+    uint64_t raw = 0;
+    if (!in.read(reinterpret_cast<char*>(&raw), sizeof(raw))) {
+        return false;
+    }
+    value = static_cast<T>(raw);
+    return true;
+}
+
+bool read_string(std::istream& in, std::string& value) {
+    uint64_t length = 0;
+    // Los nombres y timestamps son cortos; un valor enorme indica corrupcion
+    if (!read_u64(in, length) || length > 4096) {
+        return false;
+    }
+    value.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&value[0], static_cast<std::streamsize>(length)));
+}
+
+// Bytes reservados en el heap por un string; 0 si cabe en el buffer interno (SSO)
+size_t string_heap_bytes(const std::string& value) {
+    const char* data = value.data();
+    const char* object = reinterpret_cast<const char*>(&value);
+    bool inline_buffer = data >= object && data < object + sizeof(value);
+    return inline_buffer ? 0 : value.capacity() + 1;
+}
+
+} // namespace
+
+COWFileSystem::COWFileSystem(const std::string& disk_path, size_t disk_size,
+                             const TieringOptions& tiering, const ArenaOptions& arena)
+    : disk_path(disk_path), disk_size(disk_size), free_blocks_list(nullptr), stats_collector(MAX_FILES) {
+    COWFS_LOG_INFO("Initializing file system with size: " << disk_size << " bytes");
     
     total_blocks = disk_size / BLOCK_SIZE;
-    std::cout << "Total blocks: " << total_blocks << std::endl;
+    COWFS_LOG_INFO("Total blocks: " << total_blocks);
     
     file_descriptors.resize(MAX_FILES);
     inodes.resize(MAX_FILES);
+    // Sin valor inicial: las cabeceras quedan en paginas a cero sin ocupar
+    // memoria hasta que se escribe cada bloque (ver ZeroPageAllocator)
     blocks.resize(total_blocks);
+    header_arena = apply_arena_options(blocks.data(), blocks.size() * sizeof(Block), arena);
+    header_page_written.assign((blocks.size() * sizeof(Block) + system_page_size() - 1) / system_page_size(), false);
+    setup_payload_arena(tiering, arena);
 
     init_file_system();
 
-    std::cout << "File system initialized with:" << std::endl
-              << "  Max files: " << MAX_FILES << std::endl
-              << "  Block size: " << BLOCK_SIZE << " bytes" << std::endl;
+    COWFS_LOG_INFO("File system initialized with:"
+                << "\n  Max files: " << MAX_FILES
+                << "\n  Block size: " << BLOCK_SIZE << " bytes");
 
-    // Inicializar la lista de bloques libres con todo el espacio disponible
-    add_to_free_list(0, total_blocks);
+    // Inicializar la lista de bloques libres con todo el espacio disponible.
+    // El bloque 0 queda reservado: next_block == 0 marca el fin de una cadena
+    if (total_blocks > 1) {
+        add_to_free_list(1, total_blocks - 1);
+    }
 
     if (!initialize_disk()) {
+        // El destructor no se ejecuta: se libera aqui la lista de bloques libres
+        clear_free_list();
+        if (backing_fd >= 0) {
+            ::close(backing_fd);
+        }
         throw std::runtime_error("Failed to initialize disk");
     }
 }
 
 COWFileSystem::~COWFileSystem() {
     // Limpiar la lista de bloques libres
-    while (free_blocks_list) {
-        FreeBlockInfo* temp = free_blocks_list;
-        free_blocks_list = free_blocks_list->next;
-        delete temp;
-    }
-
+    clear_free_list();
 
-    std::ofstream disk(disk_path, std::ios::binary);
-    if (disk.is_open()) {
-        disk.write(reinterpret_cast<char*>(inodes.data()), inodes.size() * sizeof(Inode));
-        disk.write(reinterpret_cast<char*>(blocks.data()), blocks.size() * sizeof(Block));
+    std::vector<char> io_buffer(IMAGE_IO_BUFFER_SIZE);
+    std::ofstream disk;
+    disk.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());
+    disk.open(disk_path, std::ios::binary | std::ios::trunc);
+    if (!disk.is_open() || !save_image(disk)) {
+        COWFS_LOG_ERROR("Error: Failed to write disk image " << disk_path);
+    }
+    if (backing_fd >= 0) {
+        ::close(backing_fd);
     }
 }
 
 bool COWFileSystem::initialize_disk() {
-    std::ifstream disk(disk_path, std::ios::binary);
-    if (disk.is_open()) {
-        disk.read(reinterpret_cast<char*>(inodes.data()), inodes.size() * sizeof(Inode));
-        disk.read(reinterpret_cast<char*>(blocks.data()), blocks.size() * sizeof(Block));
-        return true;
-    } else {
-        std::ofstream new_disk(disk_path, std::ios::binary);
-        if (!new_disk.is_open()) {
+    std::vector<char> io_buffer(IMAGE_IO_BUFFER_SIZE);
+    std::ifstream disk;
+    disk.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());
+    disk.open(disk_path, std::ios::binary);
+    // Un archivo vacio se trata igual que uno inexistente
+    if (disk.is_open() && disk.peek() != std::ifstream::traits_type::eof()) {
+        if (!load_image(disk)) {
+            COWFS_LOG_ERROR("Error: Invalid or corrupt disk image " << disk_path);
             return false;
         }
+        rebuild_free_list();
+        version_record_bytes = 0;
+        for (const auto& inode : inodes) {
+            version_record_bytes += history_bytes(inode.version_history);
+            refresh_head_pins(inode);
+        }
+        return true;
+    }
+    disk.close();
+
+    // Imagen nueva: init_file_system ya dejo inodos y bloques vacios
+    std::ofstream new_disk;
+    new_disk.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());
+    new_disk.open(disk_path, std::ios::binary | std::ios::trunc);
+    if (!new_disk.is_open()) {
+        return false;
+    }
+    return save_image(new_disk);
+}
 
-        for (auto& inode : inodes) {
-            inode.is_used = false;
-            inode.filename[0] = '\0';  
-            inode.first_block = 0;
-            inode.size = 0;
-            inode.version_count = 0;
+bool COWFileSystem::save_image(std::ostream& out) const {
+    out.write(IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    write_u64(out, IMAGE_FORMAT_VERSION);
+    write_u64(out, BLOCK_SIZE);
+    write_u64(out, total_blocks);
+    write_u64(out, inodes.size());
+
+    for (const auto& inode : inodes) {
+        out.put(inode.is_used ? 1 : 0);
+        if (!inode.is_used) {
+            continue;
+        }
+        write_string(out, inode.filename);
+        write_u64(out, inode.first_block);
+        write_u64(out, inode.size);
+        write_u64(out, inode.version_count);
+        write_u64(out, inode.version_history.size());
+        for (const auto& version : inode.version_history) {
+            write_u64(out, version.version_number);
+            write_u64(out, version.block_index);
+            write_u64(out, version.size);
+            write_u64(out, version.delta_start);
+            write_u64(out, version.delta_size);
+            write_u64(out, version.prev_version);
+            write_string(out, version.timestamp);
         }
+    }
 
-        for (auto& block : blocks) {
-            block.is_used = false;
-            block.next_block = 0;
-            std::memset(block.data, 0, BLOCK_SIZE);
+    // Los bloques desalojados se copian desde el almacen de respaldo sin
+    // volver a cargarlos en memoria
+    std::vector<uint8_t> payload(BLOCK_SIZE);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const Block& block = blocks[i];
+        write_u64(out, block.next_block);
+        write_u64(out, block.ref_count);
+        out.put(block.is_used ? 1 : 0);
+        write_u64(out, block.checksum);
+        const uint8_t* data = block.data;
+        if (!data) {
+            if (!read_backing(i, payload.data())) {
+                COWFS_LOG_ERROR("Error: Could not read block " << i << " from the backing store");
+                return false;
+            }
+            data = payload.data();
         }
+        out.write(reinterpret_cast<const char*>(data), BLOCK_SIZE);
+    }
 
-        new_disk.write(reinterpret_cast<char*>(inodes.data()), inodes.size() * sizeof(Inode));
-        new_disk.write(reinterpret_cast<char*>(blocks.data()), blocks.size() * sizeof(Block));
-        return true;
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+bool COWFileSystem::load_image(std::istream& in) {
+    char magic[sizeof(IMAGE_MAGIC)];
+    uint64_t format_version = 0, block_size = 0, block_count = 0, inode_count = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, IMAGE_MAGIC, sizeof(magic)) != 0 ||
+        !read_u64(in, format_version) || !read_u64(in, block_size) ||
+        !read_u64(in, block_count) || !read_u64(in, inode_count)) {
+        return false;
+    }
+    if (format_version < 1 || format_version > IMAGE_FORMAT_VERSION || block_size != BLOCK_SIZE ||
+        block_count != total_blocks || inode_count != inodes.size()) {
+        COWFS_LOG_ERROR("Error: Disk image layout does not match (version " << format_version
+                        << ", " << block_count << " blocks of " << block_size << " bytes)");
+        return false;
+    }
+
+    for (auto& inode : inodes) {
+        int used = in.get();
+        if (used == std::istream::traits_type::eof()) {
+            return false;
+        }
+        if (!used) {
+            continue;
+        }
+        std::string filename;
+        uint64_t history_size = 0;
+        if (!read_string(in, filename) || filename.size() >= MAX_FILENAME_LENGTH ||
+            !read_u64(in, inode.first_block) || !read_u64(in, inode.size) ||
+            !read_u64(in, inode.version_count) || !read_u64(in, history_size)) {
+            return false;
+        }
+        std::strncpy(inode.filename, filename.c_str(), MAX_FILENAME_LENGTH - 1);
+        inode.is_used = true;
+        for (uint64_t v = 0; v < history_size; ++v) {
+            VersionInfo version;
+            if (!read_u64(in, version.version_number) || !read_u64(in, version.block_index) ||
+                !read_u64(in, version.size) || !read_u64(in, version.delta_start) ||
+                !read_u64(in, version.delta_size) || !read_u64(in, version.prev_version) ||
+                !read_string(in, version.timestamp) || version.block_index >= total_blocks) {
+                return false;
+            }
+            inode.version_history.push_back(std::move(version));
+        }
+    }
+
+    // El contenido y las cabeceras de los bloques libres no se guardan en
+    // memoria: el array de bloques viene a cero y sus marcos se asignan al usarlos
+    std::vector<uint8_t> unused_payload(BLOCK_SIZE);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        Block& block = blocks[i];
+        uint64_t next_block = 0, ref_count = 0;
+        if (!read_u64(in, next_block) || !read_u64(in, ref_count) || next_block >= total_blocks) {
+            return false;
+        }
+        int used = in.get();
+        uint64_t checksum = 0;
+        if (used == std::istream::traits_type::eof() ||
+            (format_version >= 2 && !read_u64(in, checksum))) {
+            return false;
+        }
+        uint8_t* data = used ? block_data_for_write(i) : unused_payload.data();
+        if (!in.read(reinterpret_cast<char*>(data), BLOCK_SIZE)) {
+            return false;
+        }
+        if (!used) {
+            continue;
+        }
+        note_headers_written(i, i + 1);
+        block.next_block = next_block;
+        block.ref_count = ref_count;
+        block.is_used = used != 0;
+        if (format_version >= 2) {
+            block.checksum = static_cast<uint32_t>(checksum);
+            block.checksum_verified = false;
+        } else {
+            // Imagen sin CRC: se toman los datos cargados como referencia
+            block.checksum = crc32c(data, BLOCK_SIZE);
+            block.checksum_verified = true;
+        }
+    }
+    return true;
+}
+
+void COWFileSystem::rebuild_free_list() {
+    clear_free_list();
+    // El bloque 0 nunca se asigna (ver constructor)
+    size_t start = 1;
+    while (start < blocks.size()) {
+        if (blocks[start].is_used) {
+            start++;
+            continue;
+        }
+        size_t count = 0;
+        while (start + count < blocks.size() && !blocks[start + count].is_used) {
+            count++;
+        }
+        add_to_free_list(start, count);
+        start += count;
     }
 }
 
 fd_t COWFileSystem::create(const std::string& filename) {
+    COWFS_TRACE_SPAN("create");
+    OperationTimer timer(stats_collector, Operation::CREATE);
+    fd_t fd = create_impl(filename);
+    timer.finish(fd >= 0);
+    if (recorder) {
+        TraceRecord record(TraceOp::CREATE);
+        record.fd = fd;
+        record.result = fd;
+        record.name = filename;
+        recorder->record(record);
+    }
+    return fd;
+}
+
+fd_t COWFileSystem::create_impl(const std::string& filename) {
     if (filename.length() >= MAX_FILENAME_LENGTH) {
-        std::cerr << "Error: Filename too long" << std::endl;
+        COWFS_LOG_ERROR("Error: Filename too long");
         return -1;
     }
 
     if (find_inode(filename) != nullptr) {
-        std::cerr << "Error: File already exists" << std::endl;
+        COWFS_LOG_ERROR("Error: File already exists");
         return -1;
     }
 
@@ -102,7 +338,7 @@ fd_t COWFileSystem::create(const std::string& filename) {
         }
     }
     if (!inode) {
-        std::cerr << "Error: No free inodes available" << std::endl;
+        COWFS_LOG_ERROR("Error: No free inodes available");
         return -1;
     }
 
@@ -117,7 +353,7 @@ fd_t COWFileSystem::create(const std::string& filename) {
 
     fd_t fd = allocate_file_descriptor();
     if (fd < 0) {
-        std::cerr << "Error: Failed to allocate file descriptor" << std::endl;
+        COWFS_LOG_ERROR("Error: Failed to allocate file descriptor");
         inode->is_used = false;  
         return -1;
     }
@@ -127,23 +363,39 @@ fd_t COWFileSystem::create(const std::string& filename) {
     file_descriptors[fd].current_position = 0;
     file_descriptors[fd].is_valid = true;
 
-    std::cout << "Successfully created file with fd: " << fd << std::endl;
+    COWFS_LOG_DEBUG("Successfully created file with fd: " << fd);
     return fd;
 }
 
 fd_t COWFileSystem::open(const std::string& filename, FileMode mode) {
+    COWFS_TRACE_SPAN("open");
+    OperationTimer timer(stats_collector, Operation::OPEN);
+    fd_t fd = open_impl(filename, mode);
+    timer.finish(fd >= 0);
+    if (recorder) {
+        TraceRecord record(TraceOp::OPEN);
+        record.fd = fd;
+        record.result = fd;
+        record.name = filename;
+        record.mode = static_cast<uint64_t>(mode);
+        recorder->record(record);
+    }
+    return fd;
+}
+
+fd_t COWFileSystem::open_impl(const std::string& filename, FileMode mode) {
     // Mostrar informacion de depuracion para ayudar a diagnosticar
-    std::cout << "Attempting to open file '" << filename << "'" << std::endl;
+    COWFS_LOG_DEBUG("Attempting to open file '" << filename << "'");
     
     Inode* inode = find_inode(filename);
     if (!inode) {
-        std::cerr << "File not found: " << filename << std::endl;
+        COWFS_LOG_ERROR("File not found: " << filename);
         return -1;
     }
 
     fd_t fd = allocate_file_descriptor();
     if (fd < 0) {
-        std::cerr << "Failed to allocate file descriptor in open" << std::endl;
+        COWFS_LOG_ERROR("Failed to allocate file descriptor in open");
         return -1;
     }
 
@@ -160,121 +412,200 @@ fd_t COWFileSystem::open(const std::string& filename, FileMode mode) {
         file_descriptors[fd].current_position = 0;
     }
 
-    std::cout << "Successfully opened file with fd: " << fd 
-              << ", mode: " << (mode == FileMode::WRITE ? "WRITE" : "READ")
-              << ", current_position: " << file_descriptors[fd].current_position 
-              << std::endl;
+    COWFS_LOG_DEBUG("Successfully opened file with fd: " << fd 
+                 << ", mode: " << (mode == FileMode::WRITE ? "WRITE" : "READ")
+                 << ", current_position: " << file_descriptors[fd].current_position);
 
     return fd;
 }
 
 ssize_t COWFileSystem::read(fd_t fd, void* buffer, size_t size) {
+    COWFS_TRACE_SPAN("read");
+    OperationTimer timer(stats_collector, Operation::READ);
+    size_t position = 0;
+    if (recorder && fd >= 0 && fd < static_cast<fd_t>(file_descriptors.size())) {
+        position = file_descriptors[fd].current_position;
+    }
+    ssize_t result = read_impl(fd, buffer, size);
+    timer.finish(result >= 0, result > 0 ? static_cast<uint64_t>(result) : 0);
+    record_file_access(fd, false, result);
+    if (recorder) {
+        TraceRecord record(TraceOp::READ);
+        record.fd = fd;
+        record.result = result;
+        record.size = size;
+        record.offset = position;
+        recorder->record(record);
+    }
+    return result;
+}
+
+ssize_t COWFileSystem::read_impl(fd_t fd, void* buffer, size_t size) {
     if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) || 
         !file_descriptors[fd].is_valid) {
-        std::cerr << "Invalid file descriptor in read" << std::endl;
+        COWFS_LOG_ERROR("Invalid file descriptor in read");
         return -1;
     }
 
     auto& fd_entry = file_descriptors[fd];
     if (!fd_entry.inode) {
-        std::cerr << "No inode associated with file descriptor in read" << std::endl;
+        COWFS_LOG_ERROR("No inode associated with file descriptor in read");
         return -1;
     }
 
     // Verificamos si el archivo esta vacio SOLO por su tamano, no por first_block
-    // ya que first_block puede ser 0 (un indice valido)
+    // ya que first_block puede ser 0 (una version sin bloques propios)
     if (fd_entry.inode->size == 0) {
-        std::cout << "read: Archivo vacio (tamano 0)" << std::endl;
+        COWFS_LOG_DEBUG("read: Archivo vacio (tamano 0)");
         return 0;
     }
-    
-    // Verificar que el primer bloque sea valido (puede ser el bloque con indice 0)
-    if (fd_entry.inode->first_block >= blocks.size() || 
-        !blocks[fd_entry.inode->first_block].is_used) {
-        std::cerr << "read: Primer bloque invalido o no usado: " 
-                  << fd_entry.inode->first_block << std::endl;
+
+    if (fd_entry.inode->version_history.empty()) {
+        COWFS_LOG_ERROR("read: Archivo sin historial de versiones");
         return -1;
     }
 
     // Calcular cuantos bytes leer basados en la posicion actual y el tamano del archivo
-    size_t bytes_to_read = std::min(size, fd_entry.inode->size - fd_entry.current_position);
+    size_t bytes_to_read = 0;
+    if (fd_entry.current_position < fd_entry.inode->size) {
+        bytes_to_read = std::min(size, fd_entry.inode->size - fd_entry.current_position);
+    }
     if (bytes_to_read == 0) {
-        std::cout << "read: Fin de archivo alcanzado (posicion actual: " 
-                  << fd_entry.current_position << ", tamano: " << fd_entry.inode->size 
-                  << ")" << std::endl;
+        COWFS_LOG_DEBUG("read: Fin de archivo alcanzado (posicion actual: " 
+                     << fd_entry.current_position << ", tamano: " << fd_entry.inode->size 
+                     << ")");
         return 0;  // EOF
     }
     
-    std::cout << "read: Leyendo " << bytes_to_read << " bytes desde la posicion " 
-              << fd_entry.current_position << std::endl;
-    std::cout << "read: Primer bloque: " << fd_entry.inode->first_block << std::endl;
+    COWFS_LOG_DEBUG("read: Leyendo " << bytes_to_read << " bytes desde la posicion " 
+                 << fd_entry.current_position);
+    COWFS_LOG_DEBUG("read: Primer bloque: " << fd_entry.inode->first_block);
 
-    // Leer datos, navegando por la cadena de bloques
-    size_t bytes_read = 0;
-    size_t current_block = fd_entry.inode->first_block;
-    size_t block_offset = fd_entry.current_position % BLOCK_SIZE;
-    size_t blocks_skipped = fd_entry.current_position / BLOCK_SIZE;
+    if (!read_version_range(*fd_entry.inode, fd_entry.inode->version_history.size() - 1,
+                            fd_entry.current_position, bytes_to_read,
+                            static_cast<uint8_t*>(buffer))) {
+        return -1;
+    }
+    size_t bytes_read = bytes_to_read;
+
+    // Actualizar la posicion actual
+    fd_entry.current_position += bytes_read;
     
-    // Saltar bloques hasta llegar a la posicion actual
-    for (size_t i = 0; i < blocks_skipped && current_block < blocks.size(); i++) {
+    COWFS_LOG_DEBUG("read: Leidos " << bytes_read << " bytes, nueva posicion: " 
+                 << fd_entry.current_position);
+              
+    return bytes_read;
+}
+
+bool COWFileSystem::read_version_data(size_t version, fd_t fd, void* buffer, size_t& size) {
+    if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) ||
+        !file_descriptors[fd].is_valid || !file_descriptors[fd].inode) {
+        COWFS_LOG_ERROR("read_version_data: Invalid file descriptor: " << fd);
+        return false;
+    }
+
+    const Inode& inode = *file_descriptors[fd].inode;
+    for (size_t i = 0; i < inode.version_history.size(); ++i) {
+        if (inode.version_history[i].version_number == version) {
+            size = std::min(size, inode.version_history[i].size);
+            return read_version_range(inode, i, 0, size, static_cast<uint8_t*>(buffer));
+        }
+    }
+    COWFS_LOG_ERROR("read_version_data: Version " << version << " not found");
+    return false;
+}
+
+bool COWFileSystem::read_version_range(const Inode& inode, size_t version_index,
+                                       size_t position, size_t length, uint8_t* out) {
+    const auto& history = inode.version_history;
+
+    while (length > 0) {
+        // Una version solo almacena [delta_start, size); los bytes anteriores
+        // son el prefijo comun con la version previa. Bajamos por el historial
+        // hasta la version que almacena el byte en 'position'.
+        size_t source = version_index;
+        size_t run_end = history[version_index].size;
+        while (position < history[source].delta_start) {
+            run_end = std::min(run_end, history[source].delta_start);
+            if (source == 0) {
+                COWFS_LOG_ERROR("read: La primera version no cubre la posicion " << position);
+                return false;
+            }
+            source--;
+        }
+
+        size_t run = std::min(length, run_end - position);
+        if (!read_chain(history[source].block_index, position - history[source].delta_start,
+                        run, out)) {
+            return false;
+        }
+        out += run;
+        position += run;
+        length -= run;
+    }
+    return true;
+}
+
+bool COWFileSystem::read_chain(size_t first_block, size_t offset, size_t length, uint8_t* out) {
+    size_t bytes_read = 0;
+    size_t current_block = first_block;
+    size_t block_offset = offset % BLOCK_SIZE;
+    size_t blocks_skipped = offset / BLOCK_SIZE;
+
+    // Saltar bloques hasta llegar a la posicion pedida
+    for (size_t i = 0; i < blocks_skipped; i++) {
         size_t next_block = blocks[current_block].next_block;
-        // Si el siguiente bloque es 0 y no estamos en el ultimo bloque que necesitamos, 
-        // consideramos esto como el fin de la cadena
-        if (next_block >= blocks.size() && i < blocks_skipped - 1) {
-            std::cerr << "read: Fin prematuro de la cadena de bloques al navegar" << std::endl;
-            return -1;
+        // next_block == 0 marca el fin de la cadena
+        if (next_block == 0 || next_block >= blocks.size()) {
+            COWFS_LOG_ERROR("read: Fin prematuro de la cadena de bloques al navegar");
+            return false;
         }
         current_block = next_block;
     }
-    
-    // Verificar si alcanzamos el final de la cadena de bloques
-    if (current_block >= blocks.size() && bytes_to_read > 0) {
-        std::cerr << "read: Error al saltar bloques para alcanzar la posicion actual" << std::endl;
-        return -1;
-    }
-    
+
     // Leer datos
-    while (bytes_read < bytes_to_read && current_block < blocks.size()) {
+    while (bytes_read < length) {
         // Verificar que el bloque este marcado como usado
-        if (!blocks[current_block].is_used) {
-            std::cerr << "Error: Attempted to read from unused block" << std::endl;
-            return -1;
+        if (current_block == 0 || current_block >= blocks.size() ||
+            !blocks[current_block].is_used) {
+            COWFS_LOG_ERROR("Error: Attempted to read from unused block");
+            return false;
         }
-        
-        size_t chunk_size = std::min(bytes_to_read - bytes_read, BLOCK_SIZE - block_offset);
-        
-        std::cout << "read: Leyendo " << chunk_size << " bytes del bloque " 
-                  << current_block << " con offset " << block_offset << std::endl;
-        
-        std::memcpy(static_cast<uint8_t*>(buffer) + bytes_read,
-                   blocks[current_block].data + block_offset,
-                   chunk_size);
-        
+        if (!verify_block(current_block)) {
+            return false;
+        }
+
+        size_t chunk_size = std::min(length - bytes_read, BLOCK_SIZE - block_offset);
+
+        COWFS_LOG_TRACE("read: Leyendo " << chunk_size << " bytes del bloque " 
+                     << current_block << " con offset " << block_offset);
+
+        std::memcpy(out + bytes_read, block_data(current_block) + block_offset, chunk_size);
+
         bytes_read += chunk_size;
         block_offset = 0; // Despues del primer bloque, siempre empezamos desde el inicio
         current_block = blocks[current_block].next_block;
     }
-
-    // Actualizar la posicion actual
-    fd_entry.current_position += bytes_read;
-    
-    std::cout << "read: Leidos " << bytes_read << " bytes, nueva posicion: " 
-              << fd_entry.current_position << std::endl;
-              
-    return bytes_read;
+    return true;
 }
 
 std::string get_current_timestamp() {
+    COWFS_TRACE_SPAN("get_current_timestamp");
     auto now = std::chrono::system_clock::now();
     auto now_c = std::chrono::system_clock::to_time_t(now);
+    // localtime() devuelve un buffer estatico compartido: varios sistemas de
+    // archivos pueden escribir a la vez desde hilos distintos
+    std::tm local{};
+    localtime_r(&now_c, &local);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_c), "%Y-%m-%d %H:%M:%S");
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 }
 
 bool COWFileSystem::find_delta(const void* old_data, const void* new_data,
                              size_t old_size, size_t new_size,
                              size_t& delta_start, size_t& delta_size) {
+    COWFS_TRACE_SPAN("find_delta");
     const uint8_t* old_bytes = static_cast<const uint8_t*>(old_data);
     const uint8_t* new_bytes = static_cast<const uint8_t*>(new_data);
     
@@ -325,29 +656,31 @@ bool COWFileSystem::find_delta(const void* old_data, const void* new_data,
 
 bool COWFileSystem::write_delta_blocks(const void* buffer, size_t size,
                                      size_t delta_start, size_t& first_block) {
+    COWFS_TRACE_SPAN("write_delta_blocks");
     if (size == 0 || delta_start >= size) {
         first_block = 0;
         return true;
     }
-    
+    return write_chain(static_cast<const uint8_t*>(buffer) + delta_start, size - delta_start, first_block);
+}
+
+bool COWFileSystem::write_chain(const uint8_t* data, size_t actual_size, size_t& first_block) {
     // Calcular cuantos bloques necesitamos
-    size_t actual_size = std::min(size - delta_start, size);
     size_t blocks_needed = (actual_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
     
-    std::cout << "write_delta_blocks: Necesitamos " << blocks_needed 
-              << " bloques para escribir " << actual_size << " bytes" << std::endl;
+    COWFS_LOG_DEBUG("write_delta_blocks: Necesitamos " << blocks_needed 
+                 << " bloques para escribir " << actual_size << " bytes");
     
     first_block = 0;
     size_t current_block = 0;
     size_t prev_block = 0;
     
-    const uint8_t* data = static_cast<const uint8_t*>(buffer) + delta_start;
     size_t remaining = actual_size;
     
     for (size_t i = 0; i < blocks_needed; i++) {
         if (!allocate_block(current_block)) {
-            std::cerr << "write_delta_blocks: No se pudo asignar el bloque " << i+1 
-                      << " de " << blocks_needed << std::endl;
+            COWFS_LOG_ERROR("write_delta_blocks: No se pudo asignar el bloque " << i+1 
+                         << " de " << blocks_needed);
             
             // Liberar los bloques que ya asignamos si fallamos
             if (first_block != 0) {
@@ -373,14 +706,18 @@ bool COWFileSystem::write_delta_blocks(const void* buffer, size_t size,
         
         // Calcular cuantos bytes escribir en este bloque
         size_t bytes_to_write = std::min(remaining, BLOCK_SIZE);
+        COWFS_TRACE_SPAN("write_delta_blocks.copy");
         
         // Copiar los datos al bloque
-        std::memcpy(blocks[current_block].data, data, bytes_to_write);
+        uint8_t* block_payload = block_data_for_write(current_block);
+        std::memcpy(block_payload, data, bytes_to_write);
         
         // Inicializar el resto del bloque con ceros si es necesario
         if (bytes_to_write < BLOCK_SIZE) {
-            std::memset(blocks[current_block].data + bytes_to_write, 0, BLOCK_SIZE - bytes_to_write);
+            std::memset(block_payload + bytes_to_write, 0, BLOCK_SIZE - bytes_to_write);
         }
+        blocks[current_block].checksum = crc32c(block_payload, BLOCK_SIZE);
+        blocks[current_block].checksum_verified = true;
         
         data += bytes_to_write;
         remaining -= bytes_to_write;
@@ -391,30 +728,182 @@ bool COWFileSystem::write_delta_blocks(const void* buffer, size_t size,
     if (prev_block < blocks.size()) {
         blocks[prev_block].next_block = 0;
     }
+
+    allocated_bytes_written += blocks_needed * BLOCK_SIZE;
+    copied_bytes_written += actual_size;
     
-    std::cout << "write_delta_blocks: Escritura exitosa en " << blocks_needed 
-              << " bloques, primer bloque: " << first_block << std::endl;
+    COWFS_LOG_DEBUG("write_delta_blocks: Escritura exitosa en " << blocks_needed 
+                 << " bloques, primer bloque: " << first_block);
     
     return true;
 }
 
+size_t COWFileSystem::import_files(std::vector<ImportedFile>& files) {
+    COWFS_TRACE_SPAN("import_files");
+
+    // Nombres existentes y libres de una sola pasada por la tabla de inodos
+    std::set<std::string> names;
+    std::vector<Inode*> free_inodes;
+    for (auto& inode : inodes) {
+        if (inode.is_used) {
+            names.insert(inode.filename);
+        } else {
+            free_inodes.push_back(&inode);
+        }
+    }
+    size_t free_block_count = 0;
+    for (FreeBlockInfo* current = free_blocks_list; current; current = current->next) {
+        free_block_count += current->block_count;
+    }
+
+    // Admitir archivos mientras haya inodos y bloques para ellos
+    size_t blocks_needed = 0;
+    size_t inodes_needed = 0;
+    for (auto& file : files) {
+        size_t file_blocks = (file.content.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (file.name.empty() || file.name.length() >= MAX_FILENAME_LENGTH) {
+            file.status = ImportStatus::INVALID_NAME;
+        } else if (!names.insert(file.name).second) {
+            file.status = ImportStatus::EXISTS;
+        } else if (inodes_needed == free_inodes.size() || blocks_needed + file_blocks > free_block_count) {
+            names.erase(file.name);
+            file.status = ImportStatus::NO_SPACE;
+        } else {
+            inodes_needed++;
+            blocks_needed += file_blocks;
+            file.status = ImportStatus::PENDING;
+        }
+    }
+
+    // Bloques de todo el lote en el menor numero de extents posible
+    std::vector<std::pair<size_t, size_t>> extents;
+    for (size_t reserved = 0; reserved < blocks_needed;) {
+        size_t start = 0, count = 0;
+        if (!allocate_extent(blocks_needed - reserved, start, count)) {
+            COWFS_LOG_ERROR("import_files: Free block map is inconsistent");
+            return 0;
+        }
+        extents.emplace_back(start, count);
+        reserved += count;
+    }
+
+    const std::string timestamp = get_current_timestamp();
+    size_t extent = 0, extent_used = 0;
+    size_t imported = 0;
+    for (auto& file : files) {
+        if (file.status != ImportStatus::PENDING) {
+            continue;
+        }
+        Inode* inode = free_inodes[imported];
+        std::strncpy(inode->filename, file.name.c_str(), MAX_FILENAME_LENGTH - 1);
+        inode->filename[MAX_FILENAME_LENGTH - 1] = '\0';
+        inode->first_block = 0;
+        inode->size = 0;
+        inode->version_count = 0;
+        inode->is_used = true;
+        version_record_bytes -= history_bytes(inode->version_history);
+        inode->version_history.clear();
+
+        // Un archivo vacio queda como tras create(): sin versiones
+        const size_t size = file.content.size();
+        if (size > 0) {
+            const size_t file_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            const bool have_checksums = file.checksums.size() == file_blocks;
+            size_t first_block = 0, prev_block = 0;
+            for (size_t i = 0; i < file_blocks; ++i) {
+                if (extent_used == extents[extent].second) {
+                    extent++;
+                    extent_used = 0;
+                }
+                size_t block = extents[extent].first + extent_used++;
+                if (i == 0) {
+                    first_block = block;
+                } else {
+                    blocks[prev_block].next_block = block;
+                }
+                size_t offset = i * BLOCK_SIZE;
+                size_t length = std::min(BLOCK_SIZE, size - offset);
+                uint8_t* payload = block_data_for_write(block);
+                std::memcpy(payload, file.content.data() + offset, length);
+                if (length < BLOCK_SIZE) {
+                    std::memset(payload + length, 0, BLOCK_SIZE - length);
+                }
+                blocks[block].checksum = have_checksums ? file.checksums[i] : crc32c(payload, BLOCK_SIZE);
+                blocks[block].checksum_verified = true;
+                blocks[block].ref_count = 1;
+                prev_block = block;
+            }
+
+            VersionInfo version;
+            version.version_number = 1;
+            version.timestamp = timestamp;
+            version.size = size;
+            version.block_index = first_block;
+            version.delta_start = 0;
+            version.delta_size = size;
+            version.prev_version = 0;
+            version.merkle = file.merkle ? file.merkle : merkle_build(file.content.data(), size);
+            inode->version_history.push_back(std::move(version));
+            inode->first_block = first_block;
+            inode->size = size;
+            inode->version_count = 1;
+
+            delta_bytes_written += size;
+            allocated_bytes_written += file_blocks * BLOCK_SIZE;
+            copied_bytes_written += size;
+        }
+        version_record_bytes += history_bytes(inode->version_history);
+        refresh_head_pins(*inode);
+        file.status = ImportStatus::IMPORTED;
+        imported++;
+    }
+
+    COWFS_LOG_DEBUG("import_files: " << imported << " files in " << extents.size() << " extents");
+    return imported;
+}
+
 ssize_t COWFileSystem::write(fd_t fd, const void* buffer, size_t size) {
-    std::cout << "Starting write operation for fd: " << fd << std::endl;
+    COWFS_TRACE_SPAN("write");
+    OperationTimer timer(stats_collector, Operation::WRITE);
+    size_t versions_before = recorder ? get_version_count(fd) : 0;
+    ssize_t result = write_impl(fd, buffer, size);
+    timer.finish(result >= 0, result > 0 ? static_cast<uint64_t>(result) : 0);
+    record_file_access(fd, true, result);
+    if (recorder) {
+        TraceRecord record(TraceOp::WRITE);
+        record.fd = fd;
+        record.result = result;
+        record.size = size;
+        record.content_hash = buffer ? content_hash(buffer, size) : 0;
+        // Sin version nueva el contenido no cambio: delta vacio al final
+        record.offset = size;
+        if (result >= 0 && get_version_count(fd) > versions_before) {
+            const VersionInfo& version = file_descriptors[fd].inode->version_history.back();
+            record.offset = version.delta_start;
+            record.delta_size = version.delta_size;
+        }
+        recorder->record(record);
+    }
+    return result;
+}
+
+ssize_t COWFileSystem::write_impl(fd_t fd, const void* buffer, size_t size) {
+    COWFS_LOG_DEBUG("Starting write operation for fd: " << fd);
     
     if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) || 
         !file_descriptors[fd].is_valid) {
-        std::cerr << "Invalid file descriptor in write" << std::endl;
+        COWFS_LOG_ERROR("Invalid file descriptor in write");
         return -1;
     }
     
     auto& fd_entry = file_descriptors[fd];
     if (fd_entry.mode != FileMode::WRITE) {
-        std::cerr << "File not opened for writing" << std::endl;
+        COWFS_LOG_ERROR("File not opened for writing");
         return -1;
     }
     
     if (!fd_entry.inode) {
-        std::cerr << "No inode associated with file descriptor" << std::endl;
+        COWFS_LOG_ERROR("No inode associated with file descriptor");
         return -1;
     }
     
@@ -451,20 +940,24 @@ ssize_t COWFileSystem::write(fd_t fd, const void* buffer, size_t size) {
             fd_entry.current_position = 0;
             
             // Leer el contenido actual
-            ssize_t bytes_read = read(fd, old_content.data(), old_size);
+            ssize_t bytes_read;
+            {
+                COWFS_TRACE_SPAN("write.read_old_content");
+                bytes_read = read_impl(fd, old_content.data(), old_size);
+            }
             
             // Restaurar la posicion
             fd_entry.current_position = saved_position;
             
             // Verificar si la lectura tuvo exito
             if (bytes_read != static_cast<ssize_t>(old_size)) {
-                std::cerr << "Error reading current content for delta detection" << std::endl;
+                COWFS_LOG_ERROR("Error reading current content for delta detection");
                 return -1;
             }
             
             // Detectar cambios entre versiones
             if (!find_delta(old_content.data(), buffer, old_size, size, delta_start, delta_size)) {
-                std::cerr << "Error detecting delta between versions" << std::endl;
+                COWFS_LOG_ERROR("Error detecting delta between versions");
                 return -1;
             }
         } else {
@@ -474,9 +967,10 @@ ssize_t COWFileSystem::write(fd_t fd, const void* buffer, size_t size) {
         }
     }
     
-    // Si no hay cambios, no crear una nueva version
-    if (delta_size == 0) {
-        std::cout << "No changes detected, not creating a new version" << std::endl;
+    // Si no hay cambios, no crear una nueva version. Un truncado (el nuevo
+    // contenido es prefijo del anterior) si crea una version, sin bloques propios
+    if (delta_size == 0 && size == old_size) {
+        COWFS_LOG_DEBUG("No changes detected, not creating a new version");
         
         // Pero si actualizamos la posicion del cursor
         fd_entry.current_position = size;
@@ -486,7 +980,7 @@ ssize_t COWFileSystem::write(fd_t fd, const void* buffer, size_t size) {
     
     // Crear una nueva cadena de bloques para la nueva version
     if (!write_delta_blocks(buffer, size, delta_start, new_first_block)) {
-        std::cerr << "Could not allocate blocks for new version" << std::endl;
+        COWFS_LOG_ERROR("Could not allocate blocks for new version");
         return -1;
     }
     
@@ -498,38 +992,60 @@ ssize_t COWFileSystem::write(fd_t fd, const void* buffer, size_t size) {
     new_version.block_index = new_first_block;
     new_version.delta_start = delta_start;
     new_version.delta_size = delta_size;
+    delta_bytes_written += delta_size;
     new_version.prev_version = (fd_entry.inode->version_count > 0) ? fd_entry.inode->version_count : 0;
+
+    // El arbol nuevo comparte con el anterior los subarboles fuera del delta
+    if (!is_first_version && !fd_entry.inode->version_history.empty() &&
+        fd_entry.inode->version_history.back().merkle) {
+        new_version.merkle = merkle_update(fd_entry.inode->version_history.back().merkle, old_size,
+                                           static_cast<const uint8_t*>(buffer), size,
+                                           delta_start, delta_start + delta_size);
+    } else {
+        new_version.merkle = merkle_build(static_cast<const uint8_t*>(buffer), size);
+    }
     
     // Incrementar la referencia a los nuevos bloques
     increment_block_refs(new_first_block);
     
     // Actualizar el inodo con la nueva informacion
+    size_t history_capacity = fd_entry.inode->version_history.capacity();
     fd_entry.inode->version_history.push_back(new_version);
+    version_record_bytes += (fd_entry.inode->version_history.capacity() - history_capacity) * sizeof(VersionInfo) +
+                            string_heap_bytes(fd_entry.inode->version_history.back().timestamp);
     fd_entry.inode->first_block = new_first_block;
     fd_entry.inode->size = size;
     fd_entry.inode->version_count++;
     
+    refresh_head_pins(*fd_entry.inode);
+
     // Actualizar la posicion del cursor
     fd_entry.current_position = size;
 
-    std::cout << "Write operation completed:"
-              << "\n  bytes written: " << size
-              << "\n  delta size: " << delta_size
-              << "\n  new version: " << fd_entry.inode->version_count
-              << "\n  new size: " << fd_entry.inode->size
-              << std::endl;
+    COWFS_LOG_DEBUG("Write operation completed:"
+                 << "\n  bytes written: " << size
+                 << "\n  delta size: " << delta_size
+                 << "\n  new version: " << fd_entry.inode->version_count
+                 << "\n  new size: " << fd_entry.inode->size);
     
     return size;
 }
 
 int COWFileSystem::close(fd_t fd) {
-    if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) || 
-        !file_descriptors[fd].is_valid) {
-        return -1;
+    int result = -1;
+    if (fd >= 0 && fd < static_cast<fd_t>(file_descriptors.size()) &&
+        file_descriptors[fd].is_valid) {
+        file_descriptors[fd].is_valid = false;
+        result = 0;
     }
 
-    file_descriptors[fd].is_valid = false;
-    return 0;
+    if (recorder) {
+        TraceRecord record(TraceOp::CLOSE);
+        record.fd = fd;
+        record.result = result;
+        recorder->record(record);
+    }
+    return result;
 }
 
 // Helper functions implementation
@@ -537,9 +1053,9 @@ Inode* COWFileSystem::find_inode(const std::string& filename) {
     for (size_t i = 0; i < inodes.size(); i++) {
         if (inodes[i].is_used) {
             // Debug output to check what's happening
-            std::cout << "Checking inode " << i << ": " 
-                     << "used=" << inodes[i].is_used 
-                     << ", filename='" << inodes[i].filename << "'" << std::endl;
+            COWFS_LOG_TRACE("Checking inode " << i << ": " 
+                        << "used=" << inodes[i].is_used 
+                        << ", filename='" << inodes[i].filename << "'");
             
             if (std::strcmp(inodes[i].filename, filename.c_str()) == 0) {
                 return &inodes[i];
@@ -565,18 +1081,22 @@ void COWFileSystem::free_file_descriptor(fd_t fd) {
 }
 
 bool COWFileSystem::allocate_block(size_t& block_index) {
+    COWFS_TRACE_SPAN("allocate_block");
+    OperationTimer timer(stats_collector, Operation::ALLOCATE_BLOCK);
+
     // Buscar el mejor bloque libre que se ajuste
     FreeBlockInfo* best_block = find_best_fit(1);
     
     if (!best_block) {
-        std::cerr << "allocate_block: No hay bloques libres disponibles" << std::endl;
-        std::cerr << "Memoria total: " << disk_size << " bytes" << std::endl;
-        std::cerr << "Memoria usada: " << get_total_memory_usage() << " bytes" << std::endl;
+        timer.finish(false);
+        COWFS_LOG_ERROR("allocate_block: No hay bloques libres disponibles");
+        COWFS_LOG_ERROR("Memoria total: " << disk_size << " bytes");
+        COWFS_LOG_ERROR("Memoria usada: " << get_total_memory_usage() << " bytes");
         return false;
     }
     
     // Si llegamos aqui, encontramos un bloque libre
-    std::cout << "allocate_block: Asignando bloque " << best_block->start_block << std::endl;
+    COWFS_LOG_TRACE("allocate_block: Asignando bloque " << best_block->start_block);
     
     block_index = best_block->start_block;
     
@@ -598,18 +1118,68 @@ bool COWFileSystem::allocate_block(size_t& block_index) {
             }
         }
         delete best_block;
+        free_list_nodes--;
     }
     
     // Inicializar el bloque
+    note_headers_written(block_index, block_index + 1);
     blocks[block_index].is_used = true;
     blocks[block_index].next_block = 0;
     blocks[block_index].ref_count = 0; // Se incrementara en increment_block_refs
     
+    timer.finish(true, BLOCK_SIZE);
+    return true;
+}
+
+bool COWFileSystem::allocate_extent(size_t max_blocks, size_t& start_block, size_t& count) {
+    COWFS_TRACE_SPAN("allocate_extent");
+
+    // El mejor ajuste para todo lo pedido o, si no cabe, el hueco mas grande
+    FreeBlockInfo* extent = find_best_fit(max_blocks);
+    if (!extent) {
+        for (FreeBlockInfo* current = free_blocks_list; current; current = current->next) {
+            if (!extent || current->block_count > extent->block_count) {
+                extent = current;
+            }
+        }
+    }
+    if (!extent || max_blocks == 0) {
+        return false;
+    }
+
+    start_block = extent->start_block;
+    count = std::min(max_blocks, extent->block_count);
+    if (extent->block_count > count) {
+        extent->start_block += count;
+        extent->block_count -= count;
+    } else {
+        if (extent == free_blocks_list) {
+            free_blocks_list = extent->next;
+        } else {
+            FreeBlockInfo* current = free_blocks_list;
+            while (current != nullptr && current->next != extent) {
+                current = current->next;
+            }
+            if (current != nullptr) {
+                current->next = extent->next;
+            }
+        }
+        delete extent;
+        free_list_nodes--;
+    }
+
+    note_headers_written(start_block, start_block + count);
+    for (size_t block = start_block; block < start_block + count; ++block) {
+        blocks[block].is_used = true;
+        blocks[block].next_block = 0;
+        blocks[block].ref_count = 0;
+    }
     return true;
 }
 
 void COWFileSystem::free_block(size_t block_index) {
     if (block_index < blocks.size()) {
+        release_block_frame(block_index);
         blocks[block_index].is_used = false;
         blocks[block_index].next_block = 0;
     }
@@ -621,14 +1191,18 @@ bool COWFileSystem::copy_block(size_t source_block, size_t& dest_block) {
     }
 
     if (source_block != 0) {
-        std::memcpy(blocks[dest_block].data, blocks[source_block].data, BLOCK_SIZE);
+        uint8_t* destination = block_data_for_write(dest_block);
+        std::memcpy(destination, block_data(source_block), BLOCK_SIZE);
         blocks[dest_block].next_block = blocks[source_block].next_block;
+        blocks[dest_block].checksum = blocks[source_block].checksum;
+        blocks[dest_block].checksum_verified = blocks[source_block].checksum_verified;
     }
 
     return true;
 }
 
 void COWFileSystem::increment_block_refs(size_t block_index) {
+    COWFS_TRACE_SPAN("increment_block_refs");
     while (block_index != 0 && block_index < blocks.size()) {
         blocks[block_index].ref_count++;
         block_index = blocks[block_index].next_block;
@@ -636,6 +1210,7 @@ void COWFileSystem::increment_block_refs(size_t block_index) {
 }
 
 void COWFileSystem::decrement_block_refs(size_t block_index) {
+    COWFS_TRACE_SPAN("decrement_block_refs");
     while (block_index != 0 && block_index < blocks.size()) {
         if (blocks[block_index].ref_count > 0) {
             blocks[block_index].ref_count--;
@@ -655,17 +1230,17 @@ void COWFileSystem::decrement_block_refs(size_t block_index) {
 std::vector<VersionInfo> COWFileSystem::get_version_history(fd_t fd) const {
     if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) || 
         !file_descriptors[fd].is_valid) {
-        std::cerr << "get_version_history: Invalid file descriptor: " << fd << std::endl;
+        COWFS_LOG_ERROR("get_version_history: Invalid file descriptor: " << fd);
         return std::vector<VersionInfo>();
     }
     
     if (!file_descriptors[fd].inode) {
-        std::cerr << "get_version_history: No inode associated with file descriptor: " << fd << std::endl;
+        COWFS_LOG_ERROR("get_version_history: No inode associated with file descriptor: " << fd);
         return std::vector<VersionInfo>();
     }
     
-    std::cout << "Retrieved version history for fd " << fd << ": " 
-              << file_descriptors[fd].inode->version_history.size() << " versions" << std::endl;
+    COWFS_LOG_DEBUG("Retrieved version history for fd " << fd << ": " 
+                 << file_descriptors[fd].inode->version_history.size() << " versions");
     
     return file_descriptors[fd].inode->version_history;
 }
@@ -683,24 +1258,39 @@ bool COWFileSystem::revert_to_version(fd_t fd, size_t version) {
 }
 
 bool COWFileSystem::rollback_to_version(fd_t fd, size_t version_number) {
-    std::cout << "Attempting rollback to version " << version_number << " for fd " << fd << std::endl;
+    COWFS_TRACE_SPAN("rollback_to_version");
+    OperationTimer timer(stats_collector, Operation::ROLLBACK);
+    bool result = rollback_impl(fd, version_number);
+    timer.finish(result);
+    if (recorder) {
+        TraceRecord record(TraceOp::ROLLBACK);
+        record.fd = fd;
+        record.result = result ? 1 : 0;
+        record.version = version_number;
+        recorder->record(record);
+    }
+    return result;
+}
+
+bool COWFileSystem::rollback_impl(fd_t fd, size_t version_number) {
+    COWFS_LOG_DEBUG("Attempting rollback to version " << version_number << " for fd " << fd);
     
     // Verificar que el descriptor de archivo sea valido
     if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) || 
         !file_descriptors[fd].is_valid) {
-        std::cerr << "Error: Invalid file descriptor for rollback" << std::endl;
+        COWFS_LOG_ERROR("Error: Invalid file descriptor for rollback");
         return false;
     }
     
     auto& fd_entry = file_descriptors[fd];
     if (!fd_entry.inode) {
-        std::cerr << "Error: No inode associated with file descriptor for rollback" << std::endl;
+        COWFS_LOG_ERROR("Error: No inode associated with file descriptor for rollback");
         return false;
     }
 
     // Verificar que la version solicitada exista
     if (version_number == 0 || version_number > fd_entry.inode->version_count) {
-        std::cerr << "Error: Version " << version_number << " does not exist (max: " << fd_entry.inode->version_count << ")" << std::endl;
+        COWFS_LOG_ERROR("Error: Version " << version_number << " does not exist (max: " << fd_entry.inode->version_count << ")");
         return false;
     }
 
@@ -714,13 +1304,13 @@ bool COWFileSystem::rollback_to_version(fd_t fd, size_t version_number) {
     }
     
     if (!target_version) {
-        std::cerr << "Error: Could not find version " << version_number << " in history" << std::endl;
+        COWFS_LOG_ERROR("Error: Could not find version " << version_number << " in history");
         return false;
     }
     
-    std::cout << "Rolling back to version " << target_version->version_number 
-              << " with block index " << target_version->block_index 
-              << " and size " << target_version->size << std::endl;
+    COWFS_LOG_DEBUG("Rolling back to version " << target_version->version_number 
+                 << " with block index " << target_version->block_index 
+                 << " and size " << target_version->size);
 
     // Guardar las versiones que vamos a mantener (hasta la version solicitada)
     std::vector<VersionInfo> kept_versions;
@@ -730,17 +1320,20 @@ bool COWFileSystem::rollback_to_version(fd_t fd, size_t version_number) {
         } else {
             // Decrementar referencias para versiones que seran eliminadas
             if (v.block_index < blocks.size()) {
-                std::cout << "Decrementing references for blocks of version " << v.version_number << std::endl;
+                COWFS_LOG_DEBUG("Decrementing references for blocks of version " << v.version_number);
                 decrement_block_refs(v.block_index);
             }
         }
     }
     
     // Actualizar el inodo con la informacion de la version objetivo
+    version_record_bytes -= history_bytes(fd_entry.inode->version_history);
     fd_entry.inode->version_history = kept_versions;
+    version_record_bytes += history_bytes(fd_entry.inode->version_history);
     fd_entry.inode->first_block = target_version->block_index;
     fd_entry.inode->size = target_version->size;
     fd_entry.inode->version_count = version_number;  // Actualizamos el contador de versiones
+    refresh_head_pins(*fd_entry.inode);
     
     // Actualizar la posicion actual en el descriptor de archivo
     // Para escritura, lo colocamos al final del archivo
@@ -751,8 +1344,8 @@ bool COWFileSystem::rollback_to_version(fd_t fd, size_t version_number) {
         fd_entry.current_position = 0; // Reset para lectura
     }
     
-    std::cout << "Rollback completed successfully. New version count: " 
-              << fd_entry.inode->version_count << std::endl;
+    COWFS_LOG_DEBUG("Rollback completed successfully. New version count: " 
+                 << fd_entry.inode->version_count);
     
     return true;
 }
@@ -798,46 +1391,350 @@ size_t COWFileSystem::get_total_memory_usage() const {
 }
 
 void COWFileSystem::garbage_collect() {
+    COWFS_TRACE_SPAN("garbage_collect");
+    OperationTimer timer(stats_collector, Operation::GARBAGE_COLLECT);
+
     std::vector<bool> block_used(blocks.size(), false);
+    if (!block_used.empty()) {
+        block_used[0] = true;  // Bloque reservado
+    }
     
     // Marcar bloques en uso
-    for (const auto& inode : inodes) {
-        if (inode.is_used) {
-            for (const auto& version : inode.version_history) {
-                size_t current_block = version.block_index;
-                while (current_block != 0 && current_block < blocks.size()) {
-                    if (blocks[current_block].ref_count > 0) {
-                        block_used[current_block] = true;
+    {
+        COWFS_TRACE_SPAN("garbage_collect.mark");
+        for (const auto& inode : inodes) {
+            if (inode.is_used) {
+                for (const auto& version : inode.version_history) {
+                    size_t current_block = version.block_index;
+                    while (current_block != 0 && current_block < blocks.size()) {
+                        if (blocks[current_block].ref_count > 0) {
+                            block_used[current_block] = true;
+                        }
+                        current_block = blocks[current_block].next_block;
                     }
-                    current_block = blocks[current_block].next_block;
                 }
             }
         }
     }
     
-    // Encontrar bloques libres contiguos
-    size_t start = 0;
-    while (start < blocks.size()) {
-        if (!block_used[start]) {
-            size_t count = 0;
-            while (start + count < blocks.size() && !block_used[start + count]) {
-                blocks[start + count].is_used = false;
-                blocks[start + count].next_block = 0;
-                blocks[start + count].ref_count = 0;
-                std::memset(blocks[start + count].data, 0, BLOCK_SIZE);
-                count++;
-            }
+    // Encontrar bloques libres contiguos. La lista se reconstruye desde cero
+    // para no duplicar rangos que ya estaban libres
+    {
+        COWFS_TRACE_SPAN("garbage_collect.sweep");
+        clear_free_list();
+        size_t start = 0;
+        while (start < blocks.size()) {
+            if (!block_used[start]) {
+                size_t count = 0;
+                while (start + count < blocks.size() && !block_used[start + count]) {
+                    // Solo se escriben las cabeceras que cambian, para no
+                    // ocupar las paginas de los bloques que nunca se usaron
+                    Block& block = blocks[start + count];
+                    if (block.is_used || block.next_block != 0 || block.ref_count != 0) {
+                        block.is_used = false;
+                        block.next_block = 0;
+                        block.ref_count = 0;
+                    }
+                    if (tiering_enabled) {
+                        release_block_frame(start + count);
+                    } else if (block.data) {
+                        std::memset(block.data, 0, BLOCK_SIZE);
+                    }
+                    count++;
+                }
             
-            if (count > 0) {
-                add_to_free_list(start, count);
-            }
+                if (count > 0) {
+                    add_to_free_list(start, count);
+                }
             
-            start += count;
+                start += count;
+            }
+            start++;
         }
-        start++;
     }
     
     merge_free_blocks();
+    if (release_memory_after_gc) {
+        release_unused_memory();
+    }
+
+    if (recorder) {
+        TraceRecord record(TraceOp::GARBAGE_COLLECT);
+        recorder->record(record);
+    }
+}
+
+FsStats COWFileSystem::stats() const {
+    return stats_collector.snapshot();
+}
+
+void COWFileSystem::set_checksum_verification(ChecksumVerification mode) {
+    checksum_verification = mode;
+}
+
+const MerkleTree& COWFileSystem::version_merkle(Inode& inode, size_t version_index) {
+    VersionInfo& version = inode.version_history[version_index];
+    if (!version.merkle && version.size > 0) {
+        std::vector<uint8_t> content(version.size);
+        if (read_version_range(inode, version_index, 0, version.size, content.data())) {
+            version.merkle = merkle_build(content.data(), content.size());
+        }
+    }
+    return version.merkle;
+}
+
+bool COWFileSystem::get_version_merkle_tree(fd_t fd, size_t version_number, MerkleTree& tree, size_t& size) {
+    if (fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) ||
+        !file_descriptors[fd].is_valid || !file_descriptors[fd].inode) {
+        COWFS_LOG_ERROR("get_version_merkle_tree: Invalid file descriptor: " << fd);
+        return false;
+    }
+    Inode& inode = *file_descriptors[fd].inode;
+    for (size_t i = 0; i < inode.version_history.size(); ++i) {
+        if (inode.version_history[i].version_number == version_number) {
+            tree = version_merkle(inode, i);
+            size = inode.version_history[i].size;
+            // Un arbol nulo con tamano no nulo indica que no se pudo leer el contenido
+            return tree || size == 0;
+        }
+    }
+    COWFS_LOG_ERROR("get_version_merkle_tree: Version " << version_number << " not found");
+    return false;
+}
+
+bool COWFileSystem::get_version_digest(fd_t fd, size_t version_number, uint64_t& digest) {
+    MerkleTree tree;
+    size_t size = 0;
+    if (!get_version_merkle_tree(fd, version_number, tree, size)) {
+        return false;
+    }
+    digest = merkle_digest(tree, size);
+    return true;
+}
+
+size_t COWFileSystem::scrub_blocks(size_t start_block, size_t max_blocks,
+                                   std::vector<BadBlock>& bad, size_t& verified_blocks) {
+    verified_blocks = 0;
+    std::vector<uint8_t> scratch(BLOCK_SIZE);
+    size_t end = std::min(blocks.size(), std::max<size_t>(start_block, 1) + max_blocks);
+    for (size_t i = std::max<size_t>(start_block, 1); i < end; ++i) {
+        Block& block = blocks[i];
+        if (!block.is_used) {
+            continue;
+        }
+        verified_blocks++;
+        // Los bloques desalojados se leen del almacen sin volver a cargarlos
+        uint32_t actual = crc32c(peek_block(i, scratch.data()), BLOCK_SIZE);
+        if (actual == block.checksum) {
+            // Una lectura posterior en modo FIRST_READ ya no necesita
+            // comprobarlo, salvo que tenga que cargarse de nuevo del almacen
+            if (block.data) {
+                block.checksum_verified = true;
+            }
+            continue;
+        }
+        bad.push_back(BadBlock{i, block.checksum, actual, block_references(i)});
+    }
+    return end < blocks.size() ? end : 0;
+}
+
+std::vector<BlockReference> COWFileSystem::block_references(size_t block_index) const {
+    std::vector<BlockReference> references;
+    for (const auto& inode : inodes) {
+        if (!inode.is_used) {
+            continue;
+        }
+        for (const auto& version : inode.version_history) {
+            size_t current = version.block_index;
+            for (size_t steps = 0; current != 0 && current < blocks.size() && steps < blocks.size(); ++steps) {
+                if (current == block_index) {
+                    references.push_back(BlockReference{inode.filename, version.version_number});
+                    break;
+                }
+                current = blocks[current].next_block;
+            }
+        }
+    }
+    return references;
+}
+
+bool COWFileSystem::verify_block(size_t block_index) {
+    const Block& block = blocks[block_index];
+    if (checksum_verification == ChecksumVerification::NONE ||
+        (checksum_verification == ChecksumVerification::FIRST_READ && block.checksum_verified)) {
+        return true;
+    }
+    return verify_block(block_index, block_data(block_index));
+}
+
+bool COWFileSystem::verify_block(size_t block_index, const uint8_t* data) {
+    Block& block = blocks[block_index];
+    if (checksum_verification == ChecksumVerification::NONE ||
+        (checksum_verification == ChecksumVerification::FIRST_READ && block.checksum_verified)) {
+        return true;
+    }
+    uint32_t actual = crc32c(data, BLOCK_SIZE);
+    if (actual != block.checksum) {
+        COWFS_LOG_ERROR("Checksum mismatch in block " << block_index << ": expected "
+                        << block.checksum << ", got " << actual);
+        return false;
+    }
+    // Una copia leida del almacen no cuenta: el bloque se verifica al cargarlo
+    if (data == block.data) {
+        block.checksum_verified = true;
+    }
+    return true;
+}
+
+std::vector<FileAccessStats> COWFileSystem::file_access_stats() const {
+    std::vector<FileAccessStats> slots = stats_collector.file_snapshot();
+    std::vector<FileAccessStats> result;
+    for (size_t i = 0; i < inodes.size() && i < slots.size(); ++i) {
+        if (!inodes[i].is_used) {
+            continue;
+        }
+        slots[i].name = inodes[i].filename;
+        result.push_back(std::move(slots[i]));
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const FileAccessStats& a, const FileAccessStats& b) { return a.heat > b.heat; });
+    return result;
+}
+
+void COWFileSystem::record_file_access(fd_t fd, bool is_write, ssize_t result) {
+    if (result < 0 || fd < 0 || fd >= static_cast<fd_t>(file_descriptors.size()) ||
+        !file_descriptors[fd].inode) {
+        return;
+    }
+    size_t slot = static_cast<size_t>(file_descriptors[fd].inode - inodes.data());
+    stats_collector.record_file_access(slot, is_write, static_cast<uint64_t>(result));
+}
+
+size_t COWFileSystem::history_bytes(const std::vector<VersionInfo>& history) {
+    size_t bytes = history.capacity() * sizeof(VersionInfo);
+    for (const auto& version : history) {
+        bytes += string_heap_bytes(version.timestamp);
+    }
+    return bytes;
+}
+
+MemoryReport COWFileSystem::memory_report() const {
+    MemoryReport report;
+    report.block_payloads = payload_arena.resident();
+    // mincore() contaria las paginas de cabeceras que solo se han leido
+    // (save_image, rebuild_free_list): se cuentan las que tienen alguna
+    // cabecera escrita. Con prefault todas estan ocupadas
+    report.block_headers = header_arena.prefaulted ? blocks.capacity() * sizeof(Block)
+                                                   : written_header_pages * system_page_size();
+    report.inode_table = inodes.capacity() * sizeof(Inode);
+    report.file_descriptors = file_descriptors.capacity() * sizeof(FileDescriptor);
+    report.version_records = version_record_bytes;
+    report.merkle_trees = merkle_node_bytes();
+    report.allocator = free_list_nodes * sizeof(FreeBlockInfo);
+    report.instrumentation = stats_collector.memory_usage();
+    report.tiering = frame_block.capacity() * sizeof(size_t) + frame_flags.capacity() +
+                     free_frames.capacity() * sizeof(size_t) + block_pins.capacity() * sizeof(uint32_t) +
+                     block_on_backing.capacity() / 8 + head_pins.capacity() * sizeof(std::vector<size_t>);
+    for (const auto& pins : head_pins) {
+        report.tiering += pins.capacity() * sizeof(size_t);
+    }
+    return report;
+}
+
+// El array de bloques empieza en una pagina (ZeroPageAllocator), asi que la
+// pagina de una cabecera depende solo de su indice
+void COWFileSystem::note_headers_written(size_t first_block, size_t end_block) {
+    if (first_block >= end_block) {
+        return;
+    }
+    const size_t page = system_page_size();
+    const size_t last_page = (end_block * sizeof(Block) - 1) / page;
+    for (size_t p = first_block * sizeof(Block) / page; p <= last_page; ++p) {
+        if (!header_page_written[p]) {
+            header_page_written[p] = true;
+            written_header_pages++;
+        }
+    }
+}
+
+// Solo las paginas completas de [first_block, end_block), como discard_pages()
+void COWFileSystem::forget_header_pages(size_t first_block, size_t end_block) {
+    const size_t page = system_page_size();
+    const size_t end_page = end_block * sizeof(Block) / page;
+    for (size_t p = (first_block * sizeof(Block) + page - 1) / page; p < end_page; ++p) {
+        if (header_page_written[p]) {
+            header_page_written[p] = false;
+            written_header_pages--;
+        }
+    }
+}
+
+AllocatorMetrics COWFileSystem::allocator_metrics() const {
+    AllocatorMetrics metrics;
+    // El bloque 0 es el centinela de fin de cadena, nunca asignable
+    metrics.total_blocks = blocks.empty() ? 0 : blocks.size() - 1;
+
+    for (const FreeBlockInfo* extent = free_blocks_list; extent != nullptr; extent = extent->next) {
+        if (extent->block_count == 0) {
+            continue;
+        }
+        metrics.free_extents++;
+        metrics.free_blocks += extent->block_count;
+        metrics.largest_free_extent = std::max<uint64_t>(metrics.largest_free_extent, extent->block_count);
+        metrics.free_extent_histogram[AllocatorMetrics::bucket_for(extent->block_count)]++;
+    }
+
+    double contiguity_sum = 0.0;
+    for (const auto& inode : inodes) {
+        if (!inode.is_used) {
+            continue;
+        }
+        uint64_t links = 0;
+        uint64_t contiguous = 0;
+        for (const auto& version : inode.version_history) {
+            size_t current = version.block_index;
+            // Limite de pasos por si una cadena estuviera corrupta
+            for (size_t steps = 0; current != 0 && current < blocks.size() && steps < blocks.size(); ++steps) {
+                size_t next = blocks[current].next_block;
+                if (next == 0) {
+                    break;
+                }
+                links++;
+                if (next == current + 1) {
+                    contiguous++;
+                }
+                current = next;
+            }
+        }
+        // Los archivos de un solo bloque por version no aportan enlaces
+        if (links > 0) {
+            contiguity_sum += static_cast<double>(contiguous) / static_cast<double>(links);
+            metrics.chains++;
+        }
+    }
+    if (metrics.chains > 0) {
+        metrics.mean_chain_contiguity = contiguity_sum / static_cast<double>(metrics.chains);
+    }
+
+    metrics.delta_bytes = delta_bytes_written;
+    metrics.allocated_bytes = allocated_bytes_written;
+    metrics.copied_bytes = copied_bytes_written;
+    return metrics;
+}
+
+bool COWFileSystem::start_recording(const std::string& trace_path) {
+    std::unique_ptr<WorkloadRecorder> new_recorder(new WorkloadRecorder(trace_path, disk_size));
+    if (!new_recorder->is_open()) {
+        COWFS_LOG_ERROR("Error: Could not create workload trace " << trace_path);
+        return false;
+    }
+    recorder = std::move(new_recorder);
+    COWFS_LOG_INFO("Recording workload trace to " << trace_path);
+    return true;
+}
+
+void COWFileSystem::stop_recording() {
+    recorder.reset();
 }
 
 void COWFileSystem::init_file_system() {
@@ -860,13 +1757,8 @@ void COWFileSystem::init_file_system() {
         inode.shared_blocks.clear();
     }
 
-    // Initialize all blocks
-    for (auto& block : blocks) {
-        block.is_used = false;
-        block.next_block = 0;
-        block.ref_count = 0;
-        std::memset(block.data, 0, BLOCK_SIZE);
-    }
+    // Los bloques no se recorren: el array y la arena vienen de paginas a
+    // cero (libres, sin enlace ni marco) y recorrerlos las ocuparia todas
 }
 
 bool COWFileSystem::merge_free_blocks() {
@@ -882,6 +1774,7 @@ bool COWFileSystem::merge_free_blocks() {
             FreeBlockInfo* temp = current->next;
             current->next = current->next->next;
             delete temp;
+            free_list_nodes--;
             merged = true;
         } else {
             current = current->next;
@@ -901,6 +1794,7 @@ bool COWFileSystem::split_free_block(FreeBlockInfo* block, size_t size_needed) {
             block->block_count - size_needed,
             block->next
         };
+        free_list_nodes++;
         
         block->block_count = size_needed;
         block->next = new_block;
@@ -909,8 +1803,18 @@ bool COWFileSystem::split_free_block(FreeBlockInfo* block, size_t size_needed) {
     return true;
 }
 
+void COWFileSystem::clear_free_list() {
+    while (free_blocks_list) {
+        FreeBlockInfo* temp = free_blocks_list;
+        free_blocks_list = free_blocks_list->next;
+        delete temp;
+    }
+    free_list_nodes = 0;
+}
+
 void COWFileSystem::add_to_free_list(size_t start, size_t count) {
     FreeBlockInfo* new_block = new FreeBlockInfo{start, count, nullptr};
+    free_list_nodes++;
     
     if (!free_blocks_list || start < free_blocks_list->start_block) {
         new_block->next = free_blocks_list;
@@ -2,13 +2,24 @@
 #define COWFS_HPP
 
 #include <cstdint>
+#include <iosfwd>
 #include <string>
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <map>
+#include "cowfs_arena.hpp"
+#include "cowfs_merkle.hpp"
+#include "cowfs_stats.hpp"
 
 namespace cowfs {
 
+namespace bench {
+struct Internals;
+}
+
+class WorkloadRecorder;
+
 constexpr size_t BLOCK_SIZE = 4096;
 constexpr size_t MAX_FILENAME_LENGTH = 255;
 constexpr size_t MAX_FILES = 1024;
@@ -28,13 +39,54 @@ struct FileStatus {
     size_t current_version;
 };
 
+// Memoria ocupada por el sistema de archivos, por categoria, en bytes
+struct MemoryReport {
+    size_t block_payloads = 0;      // Paginas residentes de la arena de contenido de los bloques
+    size_t block_headers = 0;       // Paginas residentes del array de Block (enlace, flags, refcount)
+    size_t inode_table = 0;
+    size_t file_descriptors = 0;
+    size_t version_records = 0;     // Historiales de versiones y sus timestamps
+    size_t merkle_trees = 0;        // Nodos de los arboles de Merkle vivos en el proceso
+    size_t allocator = 0;           // Nodos de la lista de bloques libres
+    size_t instrumentation = 0;     // Shards de estadisticas por hilo
+    size_t tiering = 0;             // Tablas de marcos y pines del almacenamiento por niveles
+
+    size_t total() const {
+        return block_payloads + block_headers + inode_table + file_descriptors +
+               version_records + merkle_trees + allocator + instrumentation + tiering;
+    }
+};
+
+// Cuando se comprueba el CRC32C de un bloque al leerlo
+enum class ChecksumVerification {
+    NONE,
+    FIRST_READ,     // Solo la primera lectura de cada bloque tras cargar la imagen
+    ALWAYS
+};
+
 struct Block {
-    uint8_t data[BLOCK_SIZE];
+    uint8_t* data;           // Contenido en la arena de bloques; nulo si esta desalojado (ver TieringOptions)
     size_t next_block;
     bool is_used;
+    bool checksum_verified;  // El CRC ya se comprobo (o se calculo) en memoria
+    uint32_t checksum;       // CRC32C de data, calculado al escribir el bloque
     size_t ref_count;       // Contador de referencias para bloques compartidos
 };
 
+// Version de un archivo cuya cadena incluye un bloque
+struct BlockReference {
+    std::string filename;
+    size_t version_number;
+};
+
+// Bloque cuyo contenido no coincide con su CRC32C
+struct BadBlock {
+    size_t block_index;
+    uint32_t expected_checksum;
+    uint32_t actual_checksum;
+    std::vector<BlockReference> references;
+};
+
 struct VersionInfo {
     size_t version_number;
     size_t block_index;
@@ -43,6 +95,7 @@ struct VersionInfo {
     size_t delta_start;      // Índice donde comienzan los cambios
     size_t delta_size;       // Tamaño de los cambios
     size_t prev_version;     // Referencia a la versión anterior
+    MerkleTree merkle;       // Arbol del contenido; nulo hasta calcularlo si se cargo de la imagen
 };
 
 struct Inode {
@@ -62,9 +115,84 @@ struct FreeBlockInfo {
     FreeBlockInfo* next;
 };
 
+// Almacenamiento por niveles: con ram_budget_bytes > 0 solo ese contenido de
+// bloques esta en memoria y el resto se desaloja a backing_path. Los bloques
+// de la version actual de cada archivo quedan fijados en memoria; los de
+// versiones historicas se desalojan y se vuelven a cargar al leerlos
+struct TieringOptions {
+    size_t ram_budget_bytes = 0;   // 0: todos los bloques residentes
+    std::string backing_path;      // Archivo temporal; se borra al abrirlo
+};
+
+// Modo de paginas obtenido por cada parte del array de bloques (ver ArenaOptions)
+struct BlockArenaStatus {
+    ArenaStatus content;   // Block::data
+    ArenaStatus headers;   // Array de Block: enlaces recorridos por las cadenas
+};
+
+struct TieringStats {
+    size_t frames = 0;              // Marcos de BLOCK_SIZE en memoria
+    size_t resident_blocks = 0;
+    size_t pinned_blocks = 0;       // Bloques de versiones actuales
+    uint64_t faults = 0;            // Accesos a bloques no residentes
+    uint64_t backing_reads = 0;     // Fallos servidos desde el almacen de respaldo
+    uint64_t evictions = 0;
+    uint64_t writebacks = 0;        // Desalojos que escribieron el bloque
+    uint64_t pinned_evictions = 0;  // Desalojos de bloques fijados (presupuesto insuficiente)
+};
+
+// Resultado de import_files() para cada archivo
+enum class ImportStatus {
+    PENDING,
+    IMPORTED,
+    EXISTS,          // Ya hay un archivo con ese nombre (o se repite en el lote)
+    INVALID_NAME,
+    NO_SPACE         // No quedan inodos o bloques libres
+};
+
+// Archivo preparado para import_files(). El arbol de Merkle y el CRC32C de
+// cada bloque (el ultimo rellenado con ceros) se calculan fuera del sistema
+// de archivos; si faltan, import_files() los calcula
+struct ImportedFile {
+    std::string name;
+    std::vector<uint8_t> content;
+    MerkleTree merkle;
+    std::vector<uint32_t> checksums;
+    ImportStatus status = ImportStatus::PENDING;
+};
+
+// Punto de referencia para send(): version actual y digest de cada archivo
+struct Snapshot {
+    struct Entry {
+        size_t version;
+        uint64_t digest;
+    };
+    std::map<std::string, Entry> files;
+};
+
+// Contenido de export_archive(): version actual o todo el historial
+enum class ExportScope {
+    HEAD,
+    ALL_VERSIONS
+};
+
+struct ExportOptions {
+    ExportScope scope = ExportScope::HEAD;
+    size_t window_bytes = 1 << 20;  // Bytes de contenido en memoria a la vez
+};
+
+struct ExportStats {
+    size_t entries = 0;            // Miembros escritos en el archivo
+    uint64_t content_bytes = 0;
+    size_t block_reads = 0;        // Trozos de bloque copiados
+    size_t backward_jumps = 0;     // Lecturas a un bloque anterior al ultimo leido
+};
+
 class COWFileSystem {
 public:
-    COWFileSystem(const std::string& disk_path, size_t disk_size);
+    COWFileSystem(const std::string& disk_path, size_t disk_size,
+                  const TieringOptions& tiering = TieringOptions(),
+                  const ArenaOptions& arena = ArenaOptions());
     ~COWFileSystem();
 
     fd_t create(const std::string& filename);
@@ -84,6 +212,20 @@ public:
     size_t get_total_memory_usage() const;
     void garbage_collect();
 
+    /**
+     * @brief Devuelve al sistema los trozos de la arena de bloques que no
+     *        tienen ningun bloque en uso, y sus cabeceras
+     *
+     * Sin niveles cada trozo cubre PageArena::CHUNK_BYTES de bloques
+     * consecutivos y vuelve a comprometerse al escribir en el; en los trozos
+     * con bloques en uso se descartan las paginas de los bloques libres.
+     * Con niveles, ArenaOptions::lock o ArenaOptions::prefault no hace nada.
+     * @return Bytes de contenido que dejaron de estar residentes
+     */
+    size_t release_unused_memory();
+    // Si esta activo, garbage_collect() termina con release_unused_memory()
+    void set_release_memory_after_gc(bool enabled) { release_memory_after_gc = enabled; }
+
     /**
      * @brief Revierte un archivo a una versión anterior
      * @param fd Descriptor de archivo
@@ -92,12 +234,190 @@ public:
      */
     bool rollback_to_version(fd_t fd, size_t version_number);
 
+    /**
+     * @brief Instantanea de los contadores y latencias por operacion
+     * @return Numero de llamadas, errores, bytes e histograma de latencias de
+     *         create, open, read, write, rollback_to_version, garbage_collect
+     *         y allocate_block (ver format_stats_text)
+     */
+    FsStats stats() const;
+
+    /**
+     * @brief Elige cuando read() comprueba el CRC32C de los bloques
+     *
+     * Con FIRST_READ (por defecto) solo se comprueban los bloques cargados de
+     * la imagen que aun no se han leido; los escritos en esta sesion no. Una
+     * discrepancia hace fallar la lectura.
+     */
+    void set_checksum_verification(ChecksumVerification mode);
+
+    /**
+     * @brief Verifica el CRC32C de los bloques en uso, en orden fisico
+     * @param start_block Primer bloque a examinar (el 0 nunca esta en uso)
+     * @param max_blocks Numero de bloques a examinar, en uso o no
+     * @param bad Recibe los bloques danados y las versiones que los usan
+     * @param verified_blocks Bloques en uso verificados en esta llamada
+     * @return Siguiente bloque a examinar, o 0 al llegar al final del disco
+     */
+    size_t scrub_blocks(size_t start_block, size_t max_blocks,
+                        std::vector<BadBlock>& bad, size_t& verified_blocks);
+
+    /**
+     * @brief Archivos y versiones cuya cadena incluye el bloque
+     *
+     * Recorre todas las cadenas; pensado para informar de errores, no para
+     * la ruta de lectura.
+     */
+    std::vector<BlockReference> block_references(size_t block_index) const;
+
+    /**
+     * @brief Hash del contenido de una version: raiz de su arbol de Merkle
+     *        combinada con el tamano
+     *
+     * Dos versiones, de la misma o de distintas imagenes, con el mismo digest
+     * tienen el mismo contenido. El arbol se construye en write() a partir del
+     * de la version anterior; para versiones cargadas de la imagen se
+     * construye en la primera consulta.
+     */
+    bool get_version_digest(fd_t fd, size_t version_number, uint64_t& digest);
+
+    /**
+     * @brief Arbol de Merkle de una version, para localizar con merkle_diff
+     *        los rangos que difieren de otra
+     */
+    bool get_version_merkle_tree(fd_t fd, size_t version_number, MerkleTree& tree, size_t& size);
+
+    /**
+     * @brief Estado del almacenamiento por niveles (todo a cero sin presupuesto)
+     */
+    TieringStats tiering_stats() const;
+
+    /**
+     * @brief Paginas grandes, prefault y mlock obtenidos para la arena de
+     *        bloques, que pueden ser menos de lo pedido en ArenaOptions
+     *
+     * Las cabeceras no admiten EXPLICIT y usan paginas grandes transparentes.
+     */
+    BlockArenaStatus arena_status() const;
+
+    /**
+     * @brief Crea un lote de archivos nuevos, cada uno con una sola version
+     *
+     * Reserva los bloques de todo el lote como extents contiguos del mapa
+     * libre y da de alta los inodos de una vez, sin pasar por create() y
+     * write(). El estado de cada archivo queda en su campo status.
+     * @return Numero de archivos importados
+     */
+    size_t import_files(std::vector<ImportedFile>& files);
+
+    /**
+     * @brief Version actual y digest de cada archivo (ver send)
+     */
+    Snapshot snapshot();
+
+    /**
+     * @brief Escribe en out las versiones creadas entre dos snapshots de
+     *        esta imagen, para aplicarlas con receive() en otra
+     *
+     * Cada version viaja como su delta almacenado, asi que el receptor
+     * reconstruye el mismo historial y la misma comparticion de prefijos.
+     * Si la version de un archivo en from ya no existe (hubo un rollback
+     * posterior), se envia su historial completo hasta to.
+     * @param from Snapshot base, normalmente el snapshot() del receptor;
+     *        vacio para un envio completo
+     * @param to Snapshot destino; sus versiones deben seguir existiendo
+     * @return false si to no corresponde a esta imagen o falla la escritura
+     */
+    bool send(const Snapshot& from, const Snapshot& to, std::ostream& out);
+
+    /**
+     * @brief Aplica un flujo generado por send()
+     *
+     * Cada archivo debe estar en la version base del flujo (comprobado por
+     * digest). Cada archivo se aplica de forma atomica: sus versiones se
+     * leen y se validan enteras, digest final incluido, antes de
+     * modificarlo, y si falla queda como estaba. Los archivos anteriores del
+     * flujo quedan aplicados, asi que se puede reintentar con el mismo flujo.
+     * @return false si el flujo es invalido, el receptor no esta en la base
+     *         o el contenido recibido no coincide con el digest del emisor
+     */
+    bool receive(std::istream& in);
+
+    /**
+     * @brief Escribe todos los archivos en out como un archivo tar (ustar)
+     *
+     * Los miembros se ordenan por la posicion fisica de su primer bloque y
+     * cada uno se copia por ventanas de window_bytes: dentro de la ventana
+     * los trozos se leen en orden de bloque y se colocan en su posicion
+     * logica segun el mapa de bloques de la version. Con ALL_VERSIONS cada
+     * version es un miembro "nombre@vN".
+     * @param stats Si no es nulo, recibe contadores del recorrido
+     * @return false si falla la lectura de un bloque o la escritura
+     */
+    bool export_archive(std::ostream& out, const ExportOptions& options = ExportOptions(),
+                        ExportStats* stats = nullptr);
+
+    /**
+     * @brief Fragmentacion del espacio libre, contiguidad de las cadenas y
+     *        amplificacion de escritura (ver format_allocator_metrics_text)
+     *
+     * Recorre la lista de bloques libres y las cadenas de cada archivo; los
+     * contadores de escritura se acumulan en cada write sin coste apreciable.
+     */
+    AllocatorMetrics allocator_metrics() const;
+
+    /**
+     * @brief Lecturas, escrituras, bytes, ultimo acceso y calor de cada
+     *        archivo, ordenados de mas a menos caliente
+     *
+     * read() y write() solo actualizan contadores del shard del hilo; los
+     * shards se combinan al llamar a este metodo.
+     */
+    std::vector<FileAccessStats> file_access_stats() const;
+
+    /**
+     * @brief Desglose de la memoria ocupada por bloques, inodos, versiones,
+     *        asignador y estadisticas
+     *
+     * Los historiales de versiones y la lista de bloques libres se contabilizan
+     * al modificarse; la arena de bloques se mide con mincore() y las
+     * cabeceras recorriendo el array de bloques.
+     */
+    MemoryReport memory_report() const;
+
+    /**
+     * @brief Graba las llamadas a create, open, read, write, close,
+     *        rollback_to_version y garbage_collect en una traza binaria
+     *        (ver cowfs_recorder.hpp y tools/cowfs_replay.cpp)
+     * @param trace_path Archivo de traza; se sobrescribe si existe
+     * @return false si no se pudo crear el archivo
+     */
+    bool start_recording(const std::string& trace_path);
+    void stop_recording();
+
 private:
+    // Acceso a los metodos internos desde los benchmarks (bench/bench_common.hpp)
+    friend struct bench::Internals;
+
+    // Implementaciones sin instrumentar de las operaciones publicas
+    fd_t create_impl(const std::string& filename);
+    fd_t open_impl(const std::string& filename, FileMode mode);
+    ssize_t read_impl(fd_t fd, void* buffer, size_t size);
+    ssize_t write_impl(fd_t fd, const void* buffer, size_t size);
+    bool rollback_impl(fd_t fd, size_t version_number);
+
     bool initialize_disk();
+    // Serializacion de inodos (con su historial) y bloques de la imagen
+    bool save_image(std::ostream& out) const;
+    bool load_image(std::istream& in);
+    // Reconstruye la lista de bloques libres a partir de is_used tras cargar
+    void rebuild_free_list();
     Inode* find_inode(const std::string& filename);
     fd_t allocate_file_descriptor();
     void free_file_descriptor(fd_t fd);
     bool allocate_block(size_t& block_index);
+    // Reserva hasta max_blocks bloques contiguos (count >= 1 si hay espacio)
+    bool allocate_extent(size_t max_blocks, size_t& start_block, size_t& count);
     void free_block(size_t block_index);
     bool copy_block(size_t source_block, size_t& dest_block);
 
@@ -110,18 +430,72 @@ private:
 
     std::vector<FileDescriptor> file_descriptors;
     std::vector<Inode> inodes;
-    std::vector<Block> blocks;
+    // Paginas a cero que se ocupan al escribir cada cabecera (ver cowfs_arena.hpp)
+    std::vector<Block, ZeroPageAllocator<Block>> blocks;
     std::string disk_path;
     size_t disk_size;
     size_t total_blocks;
 
+    // Contenido de los bloques (cowfs_tiering.cpp). Sin niveles la arena
+    // tiene un marco por bloque, que block_data() compromete al primer uso;
+    // con niveles tiene los marcos del presupuesto y block_data() carga el
+    // bloque si hace falta. El puntero es valido hasta el siguiente acceso a
+    // otros dos bloques
+    const uint8_t* block_data(size_t block_index);
+    uint8_t* block_data_for_write(size_t block_index);
+    void setup_payload_arena(const TieringOptions& options, const ArenaOptions& arena);
+    void log_arena_status() const;
+    size_t acquire_frame();
+    bool evict_frame(size_t frame);
+    void release_block_frame(size_t block_index);
+    bool read_backing(size_t block_index, uint8_t* out) const;
+    // Contenido para un recorrido de toda la imagen: el marco si el bloque
+    // esta en memoria o una copia en scratch si no. No lo carga ni toca los
+    // bits del reloj
+    const uint8_t* peek_block(size_t block_index, uint8_t* scratch) const;
+    // Fija en memoria los bloques de la version actual del inodo
+    void refresh_head_pins(const Inode& inode);
+
+    PageArena payload_arena;
+    ArenaStatus header_arena;
+    size_t payload_frames = 0;
+    bool tiering_enabled = false;
+    int backing_fd = -1;
+    std::vector<size_t> frame_block;          // Bloque de cada marco (0: libre)
+    std::vector<uint8_t> frame_flags;         // FRAME_REFERENCED | FRAME_DIRTY
+    std::vector<size_t> free_frames;
+    size_t clock_hand = 0;
+    size_t recent_blocks[2] = {0, 0};        // No se desalojan: punteros en uso
+    std::vector<uint32_t> block_pins;
+    std::vector<bool> block_on_backing;       // El almacen tiene la copia vigente
+    std::vector<std::vector<size_t>> head_pins;  // Bloques fijados por cada inodo
+    TieringStats tiering_counters;
+
+    bool release_memory_after_gc = false;
+
+    ChecksumVerification checksum_verification = ChecksumVerification::FIRST_READ;
+    bool verify_block(size_t block_index);
+    bool verify_block(size_t block_index, const uint8_t* data);
+
     // Lista enlazada de bloques libres
     FreeBlockInfo* free_blocks_list;
+    size_t free_list_nodes = 0;
+
+    // Suma de history_bytes() de todos los inodos (ver memory_report)
+    size_t version_record_bytes = 0;
+    // Paginas del array de bloques con alguna cabecera escrita (ver
+    // memory_report). Se marcan al asignar o cargar un bloque y se olvidan
+    // al descartarlas en release_unused_memory()
+    std::vector<bool> header_page_written;
+    size_t written_header_pages = 0;
+    void note_headers_written(size_t first_block, size_t end_block);
+    void forget_header_pages(size_t first_block, size_t end_block);
     
     // Nuevos métodos privados para gestión de memoria
     bool merge_free_blocks();
     bool split_free_block(FreeBlockInfo* block, size_t size_needed);
     void add_to_free_list(size_t start, size_t count);
+    void clear_free_list();
     FreeBlockInfo* find_best_fit(size_t blocks_needed);
 
     void init_file_system();
@@ -132,9 +506,50 @@ private:
                    size_t& delta_start, size_t& delta_size);
     bool write_delta_blocks(const void* buffer, size_t size, 
                           size_t delta_start, size_t& first_block);
+    // Escribe length bytes en una cadena nueva (length > 0)
+    bool write_chain(const uint8_t* data, size_t length, size_t& first_block);
     bool read_version_data(size_t version, fd_t fd, void* buffer, size_t& size);
+    bool read_version_range(const Inode& inode, size_t version_index,
+                            size_t position, size_t length, uint8_t* out);
+    // Envio y recepcion de versiones (cowfs_send.cpp)
+    struct ReceivedVersion {
+        VersionInfo info;
+        std::vector<uint8_t> stored;   // Bytes [delta_start, size) de la version
+    };
+    // Comprueba la base, la cadena de versiones y el digest final antes de
+    // modificar el archivo; si luego falta espacio lo deja como estaba
+    bool apply_received_file(const std::string& name, bool replace, size_t base_version, uint64_t base_digest,
+                             const std::vector<ReceivedVersion>& received, uint64_t target_digest);
+    bool append_received_version(Inode& inode, VersionInfo version, const uint8_t* stored, size_t stored_size);
+    // Descarta las versiones a partir de keep y suelta sus bloques
+    void truncate_history(Inode& inode, size_t keep);
+    // Trozos (posicion logica, bloque, offset, longitud) de una version (cowfs_export.cpp)
+    struct ChainExtent {
+        size_t position;
+        size_t block;
+        size_t block_offset;
+        size_t length;
+    };
+    bool version_extents(const Inode& inode, size_t version_index, std::vector<ChainExtent>& extents);
+
+    // Arbol de la version, construyendolo desde su contenido si falta
+    const MerkleTree& version_merkle(Inode& inode, size_t version_index);
+    bool read_chain(size_t first_block, size_t offset, size_t length, uint8_t* out);
     void increment_block_refs(size_t block_index);
     void decrement_block_refs(size_t block_index);
+    void record_file_access(fd_t fd, bool is_write, ssize_t result);
+    // Bytes de heap de un historial: capacidad del vector mas timestamps
+    static size_t history_bytes(const std::vector<VersionInfo>& history);
+
+    StatsCollector stats_collector;
+
+    // Contadores de write_amplification (ver AllocatorMetrics)
+    uint64_t delta_bytes_written = 0;
+    uint64_t allocated_bytes_written = 0;
+    uint64_t copied_bytes_written = 0;
+
+    // Grabador de llamadas publicas; nulo si no se esta grabando
+    std::unique_ptr<WorkloadRecorder> recorder;
 };
 
 } 
@@ -0,0 +1,239 @@
+#include "cowfs_arena.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace cowfs {
+
+namespace {
+
+// Tamano de pagina grande por defecto en x86-64 y AArch64
+constexpr size_t HUGE_PAGE_BYTES = 2 << 20;
+
+// Mapeo anonimo alineado a HUGE_PAGE_BYTES, para que las paginas grandes
+// transparentes puedan cubrir toda la region
+void* map_aligned(size_t bytes, int prot) {
+    const size_t padded = bytes + HUGE_PAGE_BYTES;
+    void* raw = ::mmap(nullptr, padded, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (start + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    if (aligned > start) {
+        ::munmap(raw, aligned - start);
+    }
+    uintptr_t end = (aligned + bytes + system_page_size() - 1) & ~(system_page_size() - 1);
+    if (start + padded > end) {
+        ::munmap(reinterpret_cast<void*>(end), start + padded - end);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
+
+// madvise(MADV_HUGEPAGE) solo tiene efecto si THP no esta en "never"
+bool advise_huge_pages(void* address, size_t bytes) {
+    if (::madvise(address, bytes, MADV_HUGEPAGE) != 0) {
+        COWFS_LOG_WARN("Block arena: Transparent huge pages are not supported (" << std::strerror(errno) << ")");
+        return false;
+    }
+    std::ifstream setting("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string line;
+    if (std::getline(setting, line) && line.find("[never]") != std::string::npos) {
+        COWFS_LOG_WARN("Block arena: Transparent huge pages are disabled by the system");
+        return false;
+    }
+    return true;
+}
+
+// Ocupa las paginas de la region para que el primer acceso no tenga fallo
+void populate(void* address, size_t bytes) {
+#ifdef MADV_POPULATE_WRITE
+    if (::madvise(address, bytes, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    // Nucleos anteriores a 5.14: una escritura por pagina
+    volatile uint8_t* pages = static_cast<volatile uint8_t*>(address);
+    for (size_t offset = 0; offset < bytes; offset += system_page_size()) {
+        pages[offset] = pages[offset];
+    }
+}
+
+bool lock_pages(void* address, size_t bytes, bool prefaulted) {
+    // Sin prefault, MLOCK_ONFAULT bloquea cada pagina al ocuparse y mantiene
+    // el crecimiento por demanda
+    int result = prefaulted ? ::mlock(address, bytes) : ::mlock2(address, bytes, MLOCK_ONFAULT);
+    if (result != 0) {
+        COWFS_LOG_WARN("Block arena: Could not lock " << bytes << " bytes (" << std::strerror(errno)
+                       << "); check RLIMIT_MEMLOCK");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+const char* huge_pages_name(HugePages mode) {
+    switch (mode) {
+        case HugePages::TRANSPARENT: return "transparent";
+        case HugePages::EXPLICIT: return "explicit";
+        default: return "none";
+    }
+}
+
+size_t system_page_size() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+void* map_zeroed_pages(size_t bytes) {
+    if (bytes == 0) {
+        return nullptr;
+    }
+    // MAP_NORESERVE: el sistema no reserva swap para paginas que no se escriben
+    if (bytes >= HUGE_PAGE_BYTES) {
+        return map_aligned(bytes, PROT_READ | PROT_WRITE);
+    }
+    void* address = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return address == MAP_FAILED ? nullptr : address;
+}
+
+void unmap_pages(void* address, size_t bytes) {
+    if (address && bytes > 0) {
+        ::munmap(address, bytes);
+    }
+}
+
+void discard_pages(void* begin, void* end) {
+    const size_t page = system_page_size();
+    uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page - 1) & ~(page - 1);
+    uintptr_t last = reinterpret_cast<uintptr_t>(end) & ~(page - 1);
+    if (first < last) {
+        ::madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+    }
+}
+
+ArenaStatus apply_arena_options(void* address, size_t bytes, const ArenaOptions& options) {
+    ArenaStatus status;
+    if (!address || bytes == 0) {
+        return status;
+    }
+    if (options.huge_pages != HugePages::NONE && advise_huge_pages(address, bytes)) {
+        status.huge_pages = HugePages::TRANSPARENT;
+    }
+    if (options.prefault) {
+        populate(address, bytes);
+        status.prefaulted = true;
+    }
+    status.locked = options.lock && lock_pages(address, bytes, status.prefaulted);
+    return status;
+}
+
+size_t resident_bytes(const void* address, size_t bytes) {
+    if (!address || bytes == 0) {
+        return 0;
+    }
+    const size_t page = system_page_size();
+    uintptr_t first = reinterpret_cast<uintptr_t>(address) & ~(page - 1);
+    uintptr_t last = reinterpret_cast<uintptr_t>(address) + bytes;
+    size_t pages = (last - first + page - 1) / page;
+    std::vector<unsigned char> present(pages);
+    if (::mincore(reinterpret_cast<void*>(first), last - first, present.data()) != 0) {
+        return 0;
+    }
+    size_t resident = 0;
+    for (unsigned char flags : present) {
+        resident += flags & 1;
+    }
+    return resident * page;
+}
+
+PageArena::~PageArena() {
+    unmap_pages(base, reserved_bytes);
+}
+
+void PageArena::reserve(size_t frame_count, size_t size, const ArenaOptions& options) {
+    unmap_pages(base, reserved_bytes);
+    base = nullptr;
+    reserved_bytes = 0;
+    frame_size = size;
+    chunk_frames = std::max<size_t>(CHUNK_BYTES / size, 1);
+    committed.assign((frame_count + chunk_frames - 1) / chunk_frames, false);
+    committed_chunks = 0;
+    mode = ArenaStatus();
+    if (committed.empty()) {
+        return;
+    }
+
+    size_t bytes = committed.size() * chunk_frames * frame_size;
+    void* address = nullptr;
+    if (options.huge_pages == HugePages::EXPLICIT) {
+        // Sin MAP_NORESERVE el pool se reserva ahora: si no alcanza falla
+        // aqui y no con SIGBUS al ocupar una pagina
+        address = ::mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (address == MAP_FAILED) {
+            COWFS_LOG_WARN("Block arena: No explicit huge pages for " << bytes << " bytes ("
+                           << std::strerror(errno) << "); falling back to transparent huge pages");
+            address = nullptr;
+        } else {
+            mode.huge_pages = HugePages::EXPLICIT;
+        }
+    }
+    if (!address) {
+        address = map_aligned(bytes, PROT_NONE);
+    }
+    if (!address) {
+        committed.clear();
+        throw std::runtime_error("Block arena: could not reserve " + std::to_string(bytes) + " bytes");
+    }
+    base = static_cast<uint8_t*>(address);
+    reserved_bytes = bytes;
+
+    if (options.huge_pages != HugePages::NONE && mode.huge_pages != HugePages::EXPLICIT &&
+        advise_huge_pages(base, reserved_bytes)) {
+        mode.huge_pages = HugePages::TRANSPARENT;
+    }
+    if (options.prefault) {
+        for (size_t chunk = 0; chunk < committed.size(); ++chunk) {
+            commit_chunk(chunk);
+        }
+        populate(base, reserved_bytes);
+        mode.prefaulted = true;
+    }
+    mode.locked = options.lock && lock_pages(base, reserved_bytes, mode.prefaulted);
+}
+
+void PageArena::commit_chunk(size_t chunk) {
+    const size_t chunk_bytes = chunk_frames * frame_size;
+    if (::mprotect(base + chunk * chunk_bytes, chunk_bytes, PROT_READ | PROT_WRITE) != 0) {
+        COWFS_LOG_ERROR("Block arena: Could not commit chunk " << chunk << " (" << chunk_bytes << " bytes)");
+        throw std::runtime_error("Block arena: out of memory");
+    }
+    committed[chunk] = true;
+    committed_chunks++;
+}
+
+void PageArena::release_chunk(size_t chunk) {
+    // madvise(MADV_DONTNEED) no se permite sobre paginas bloqueadas, y una
+    // arena con prefault debe seguir ocupada entera para que status() sea cierto
+    if (!committed[chunk] || mode.locked || mode.prefaulted) {
+        return;
+    }
+    const size_t chunk_bytes = chunk_frames * frame_size;
+    uint8_t* start = base + chunk * chunk_bytes;
+    // MADV_DONTNEED libera las paginas; PROT_NONE hace que un acceso sin
+    // commit() falle en lugar de volver a ocupar memoria sin contabilizar
+    ::madvise(start, chunk_bytes, MADV_DONTNEED);
+    ::mprotect(start, chunk_bytes, PROT_NONE);
+    committed[chunk] = false;
+    committed_chunks--;
+}
+
+} // namespace cowfs
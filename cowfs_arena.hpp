@@ -0,0 +1,146 @@
+#ifndef COWFS_ARENA_HPP
+#define COWFS_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Memoria de los bloques reservada como espacio de direcciones. Las paginas
+// anonimas no ocupan RAM hasta que se escriben y se leen como ceros, asi que
+// una imagen grande y casi vacia no cuesta mas que lo que tiene en uso.
+
+namespace cowfs {
+
+enum class HugePages {
+    NONE,
+    TRANSPARENT,   // madvise(MADV_HUGEPAGE): el nucleo usa paginas de 2 MiB al ocuparlas si puede
+    EXPLICIT       // MAP_HUGETLB: reserva al construir paginas del pool de hugetlbfs para toda la arena
+};
+
+// Paginas de la arena de bloques, para despliegues sensibles a la latencia.
+// Las paginas grandes reducen los fallos de TLB al recorrer cadenas de bloques
+struct ArenaOptions {
+    HugePages huge_pages = HugePages::NONE;
+    bool prefault = false;   // Compromete y ocupa toda la arena al construir
+    bool lock = false;       // mlock; sin prefault cada pagina se bloquea al ocuparse
+};
+
+// Configuracion obtenida, que puede quedarse por debajo de la pedida (sin
+// paginas del pool, THP desactivado o RLIMIT_MEMLOCK insuficiente)
+struct ArenaStatus {
+    HugePages huge_pages = HugePages::NONE;
+    bool prefaulted = false;
+    bool locked = false;
+};
+
+const char* huge_pages_name(HugePages mode);
+
+// Reserva de bytes por separado del mapeo para que std::vector no llame a
+// new/delete con tamanos de varios gigabytes
+void* map_zeroed_pages(size_t bytes);
+void unmap_pages(void* address, size_t bytes);
+// Devuelve al sistema las paginas completas de [begin, end); se releen como ceros
+void discard_pages(void* begin, void* end);
+// Aplica options a una region ya mapeada con map_zeroed_pages(). EXPLICIT
+// se trata como TRANSPARENT: la region ya no puede pasar a hugetlbfs
+ArenaStatus apply_arena_options(void* address, size_t bytes, const ArenaOptions& options);
+// Bytes de [address, address + bytes) presentes en RAM segun mincore. Cuenta
+// tambien las paginas a cero que solo se han leido
+size_t resident_bytes(const void* address, size_t bytes);
+size_t system_page_size();
+
+/**
+ * @brief Asignador de paginas anonimas para arrays de tipos triviales
+ *
+ * resize() sin valor deja los elementos sin inicializar en lugar de ponerlos
+ * a cero: la memoria ya viene a cero y no se toca hasta usar cada elemento.
+ */
+template <typename T>
+struct ZeroPageAllocator {
+    using value_type = T;
+
+    ZeroPageAllocator() = default;
+    template <typename U>
+    ZeroPageAllocator(const ZeroPageAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        void* address = map_zeroed_pages(count * sizeof(T));
+        if (!address) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(address);
+    }
+    void deallocate(T* address, size_t count) { unmap_pages(address, count * sizeof(T)); }
+
+    template <typename U>
+    void construct(U* address) { ::new (static_cast<void*>(address)) U; }
+    template <typename U, typename... Args>
+    void construct(U* address, Args&&... args) {
+        ::new (static_cast<void*>(address)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    bool operator==(const ZeroPageAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const ZeroPageAllocator<U>&) const { return false; }
+};
+
+/**
+ * @brief Array de marcos de tamano fijo que se compromete por trozos
+ *
+ * reserve() solo reserva espacio de direcciones (PROT_NONE). Cada trozo se
+ * hace accesible la primera vez que se pide uno de sus marcos y release()
+ * lo devuelve al sistema; un marco de un trozo recien comprometido vale cero.
+ * Con ArenaOptions::prefault todos los trozos se comprometen en reserve().
+ */
+class PageArena {
+public:
+    // 16 MiB: pocas llamadas a mprotect y multiplo de las paginas grandes de 2 MiB
+    static constexpr size_t CHUNK_BYTES = 16 << 20;
+
+    PageArena() = default;
+    ~PageArena();
+    PageArena(const PageArena&) = delete;
+    PageArena& operator=(const PageArena&) = delete;
+
+    // Lanza std::runtime_error si no hay espacio de direcciones
+    void reserve(size_t frame_count, size_t frame_size, const ArenaOptions& options = ArenaOptions());
+    const ArenaStatus& status() const { return mode; }
+
+    uint8_t* frame(size_t index) const { return base + index * frame_size; }
+    size_t index_of(const uint8_t* address) const { return static_cast<size_t>(address - base) / frame_size; }
+    // Compromete el trozo del marco; lanza std::runtime_error si el sistema no da la memoria
+    void commit(size_t index) {
+        if (!committed[index / chunk_frames]) {
+            commit_chunk(index / chunk_frames);
+        }
+    }
+    bool is_committed(size_t index) const { return committed[index / chunk_frames]; }
+
+    size_t frames_per_chunk() const { return chunk_frames; }
+    size_t chunk_count() const { return committed.size(); }
+    bool chunk_committed(size_t chunk) const { return committed[chunk]; }
+    // Devuelve el trozo al sistema; sus marcos dejan de ser accesibles. No
+    // hace nada si la arena esta bloqueada con mlock u ocupada con prefault
+    void release_chunk(size_t chunk);
+
+    size_t committed_bytes() const { return committed_chunks * chunk_frames * frame_size; }
+    size_t resident() const { return base ? resident_bytes(base, reserved_bytes) : 0; }
+
+private:
+    void commit_chunk(size_t chunk);
+
+    uint8_t* base = nullptr;
+    size_t reserved_bytes = 0;
+    size_t frame_size = 0;
+    size_t chunk_frames = 1;
+    std::vector<bool> committed;
+    size_t committed_chunks = 0;
+    ArenaStatus mode;
+};
+
+} // namespace cowfs
+
+#endif // COWFS_ARENA_HPP
@@ -0,0 +1,249 @@
+#include "cowfs_checksum.hpp"
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define COWFS_CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define COWFS_CRC32C_ARM 1
+#endif
+
+namespace cowfs {
+
+namespace {
+
+// Polinomio de Castagnoli en forma reflejada
+constexpr uint32_t CRC32C_POLY = 0x82F63B78u;
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[k][b]: CRC de b seguido de k bytes a cero
+constexpr CrcTables make_tables() {
+    CrcTables tables{};
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        tables[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+        for (size_t k = 1; k < 8; ++k) {
+            uint32_t prev = tables[k - 1][b];
+            tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr CrcTables TABLES = make_tables();
+
+uint32_t crc32c_slicing_by_8(const uint8_t* data, size_t size, uint32_t crc) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xFF];
+        size--;
+    }
+    while (size >= 8) {
+        // Lectura little-endian; memcpy evita accesos no alineados o con aliasing
+        uint32_t low = 0, high = 0;
+        std::memcpy(&low, data, 4);
+        std::memcpy(&high, data + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+        crc = TABLES[7][low & 0xFF] ^ TABLES[6][(low >> 8) & 0xFF] ^
+              TABLES[5][(low >> 16) & 0xFF] ^ TABLES[4][low >> 24] ^
+              TABLES[3][high & 0xFF] ^ TABLES[2][(high >> 8) & 0xFF] ^
+              TABLES[1][(high >> 16) & 0xFF] ^ TABLES[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xFF];
+        size--;
+    }
+    return crc;
+}
+
+#if defined(COWFS_CRC32C_X86)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(const uint8_t* data, size_t size, uint32_t crc) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        size--;
+    }
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (size >= 4) {
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        size -= 4;
+    }
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        size--;
+    }
+    return crc;
+}
+#endif
+
+#if defined(COWFS_CRC32C_ARM)
+uint32_t crc32c_armv8(const uint8_t* data, size_t size, uint32_t crc) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = __crc32cb(crc, *data++);
+        size--;
+    }
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = __crc32cb(crc, *data++);
+        size--;
+    }
+    return crc;
+}
+#endif
+
+using CrcFunction = uint32_t (*)(const uint8_t*, size_t, uint32_t);
+
+struct CrcImplementation {
+    CrcFunction function;
+    const char* name;
+};
+
+CrcImplementation select_implementation() {
+#if defined(COWFS_CRC32C_X86)
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {crc32c_sse42, "sse4.2"};
+    }
+#elif defined(COWFS_CRC32C_ARM)
+    // Sin deteccion en tiempo de ejecucion: el binario ya exige +crc
+    return {crc32c_armv8, "armv8-crc"};
+#endif
+    return {crc32c_slicing_by_8, "slicing-by-8"};
+}
+
+const CrcImplementation& implementation() {
+    static const CrcImplementation selected = select_implementation();
+    return selected;
+}
+
+constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t value, unsigned bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read_le64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+inline uint32_t read_le32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    return rotl64(acc, 31) * XXH_PRIME64_1;
+}
+
+inline uint64_t xxh64_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh64_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+} // namespace
+
+uint32_t crc32c(const void* data, size_t size, uint32_t crc) {
+    return ~implementation().function(static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+const char* crc32c_implementation() {
+    return implementation().name;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const uint8_t* end = bytes + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, read_le64(bytes));
+            v2 = xxh64_round(v2, read_le64(bytes + 8));
+            v3 = xxh64_round(v3, read_le64(bytes + 16));
+            v4 = xxh64_round(v4, read_le64(bytes + 24));
+            bytes += 32;
+        } while (end - bytes >= 32);
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge(hash, v1);
+        hash = xxh64_merge(hash, v2);
+        hash = xxh64_merge(hash, v3);
+        hash = xxh64_merge(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME64_5;
+    }
+    hash += static_cast<uint64_t>(size);
+
+    while (end - bytes >= 8) {
+        hash ^= xxh64_round(0, read_le64(bytes));
+        hash = rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        bytes += 8;
+    }
+    if (end - bytes >= 4) {
+        hash ^= static_cast<uint64_t>(read_le32(bytes)) * XXH_PRIME64_1;
+        hash = rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        bytes += 4;
+    }
+    while (bytes < end) {
+        hash ^= static_cast<uint64_t>(*bytes) * XXH_PRIME64_5;
+        hash = rotl64(hash, 11) * XXH_PRIME64_1;
+        bytes++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+} // namespace cowfs
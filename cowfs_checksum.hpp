@@ -0,0 +1,33 @@
+#ifndef COWFS_CHECKSUM_HPP
+#define COWFS_CHECKSUM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cowfs {
+
+/**
+ * @brief CRC32C (Castagnoli) de un buffer
+ *
+ * Usa la instruccion crc32 de SSE4.2 si la CPU la soporta (deteccion en
+ * tiempo de ejecucion), las instrucciones CRC de ARMv8 si se compila con
+ * +crc, y slicing-by-8 en otro caso. Todas dan el mismo resultado.
+ *
+ * @param crc CRC de los bytes anteriores, para calcularlo por partes
+ */
+uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0);
+
+// Implementacion elegida: "sse4.2", "armv8-crc" o "slicing-by-8"
+const char* crc32c_implementation();
+
+/**
+ * @brief Hash de 64 bits no criptografico (XXH64)
+ *
+ * Para comparar contenidos (arboles de Merkle): detecta diferencias
+ * accidentales, no manipulaciones intencionadas.
+ */
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+} // namespace cowfs
+
+#endif // COWFS_CHECKSUM_HPP
@@ -0,0 +1,250 @@
+#include "cowfs.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <sstream>
+
+namespace cowfs {
+
+namespace {
+
+constexpr size_t TAR_BLOCK = 512;
+constexpr size_t TAR_NAME_LENGTH = 100;
+
+// Campo numerico de la cabecera: octal con ceros a la izquierda y NUL final
+void put_octal(char* field, size_t width, uint64_t value) {
+    std::ostringstream ss;
+    ss << std::oct << std::setw(static_cast<int>(width - 1)) << std::setfill('0') << value;
+    std::memcpy(field, ss.str().data(), width - 1);
+    field[width - 1] = '\0';
+}
+
+void write_tar_header(std::ostream& out, const std::string& name, uint64_t size, char type, time_t mtime) {
+    char header[TAR_BLOCK] = {};
+    std::memcpy(header, name.data(), std::min(name.size(), TAR_NAME_LENGTH));
+    put_octal(header + 100, 8, 0644);
+    put_octal(header + 108, 8, 0);
+    put_octal(header + 116, 8, 0);
+    put_octal(header + 124, 12, size);
+    put_octal(header + 136, 12, static_cast<uint64_t>(mtime));
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+
+    // La suma se calcula con el campo de checksum lleno de espacios
+    std::memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (unsigned char c : header) {
+        sum += c;
+    }
+    put_octal(header + 148, 7, sum);
+    out.write(header, TAR_BLOCK);
+}
+
+void write_tar_padding(std::ostream& out, uint64_t size) {
+    static const char zeros[TAR_BLOCK] = {};
+    size_t padding = (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+    out.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+// Los nombres de mas de 100 bytes van en una cabecera pax ("path=")
+void write_member_header(std::ostream& out, const std::string& name, uint64_t size, time_t mtime) {
+    if (name.size() > TAR_NAME_LENGTH) {
+        std::string record = " path=" + name + "\n";
+        // La longitud del registro incluye sus propios digitos
+        size_t length = record.size();
+        length += std::to_string(length + std::to_string(length).size()).size();
+        record = std::to_string(length) + record;
+        write_tar_header(out, "PaxHeader", record.size(), 'x', mtime);
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        write_tar_padding(out, record.size());
+    }
+    write_tar_header(out, name, size, '0', mtime);
+}
+
+time_t parse_timestamp(const std::string& timestamp) {
+    std::tm tm = {};
+    std::istringstream ss(timestamp);
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    if (ss.fail()) {
+        return 0;
+    }
+    tm.tm_isdst = -1;
+    time_t result = std::mktime(&tm);
+    return result < 0 ? 0 : result;
+}
+
+// version_index de un archivo creado pero nunca escrito
+constexpr size_t NO_VERSION = static_cast<size_t>(-1);
+
+struct ExportMember {
+    const Inode* inode;
+    size_t version_index;  // NO_VERSION si el archivo no tiene versiones
+    size_t first_block;    // Bloque de la posicion 0; 0 si la version esta vacia
+    std::string name;
+};
+
+} // namespace
+
+bool COWFileSystem::version_extents(const Inode& inode, size_t version_index, std::vector<ChainExtent>& extents) {
+    const auto& history = inode.version_history;
+    extents.clear();
+    size_t position = 0;
+    size_t length = history[version_index].size;
+
+    // Mismo recorrido que read_version_range, registrando los bloques en
+    // lugar de copiarlos
+    while (length > 0) {
+        size_t source = version_index;
+        size_t run_end = history[version_index].size;
+        while (position < history[source].delta_start) {
+            run_end = std::min(run_end, history[source].delta_start);
+            if (source == 0) {
+                COWFS_LOG_ERROR("export: La primera version no cubre la posicion " << position);
+                return false;
+            }
+            source--;
+        }
+
+        size_t run = std::min(length, run_end - position);
+        size_t chain_offset = position - history[source].delta_start;
+        size_t block = history[source].block_index;
+        for (size_t i = 0; i < chain_offset / BLOCK_SIZE && block != 0; i++) {
+            block = blocks[block].next_block;
+        }
+        size_t block_offset = chain_offset % BLOCK_SIZE;
+        size_t done = 0;
+        while (done < run) {
+            if (block == 0 || block >= blocks.size() || !blocks[block].is_used) {
+                COWFS_LOG_ERROR("export: Fin prematuro de la cadena de bloques");
+                return false;
+            }
+            size_t chunk = std::min(run - done, BLOCK_SIZE - block_offset);
+            extents.push_back(ChainExtent{position + done, block, block_offset, chunk});
+            done += chunk;
+            block_offset = 0;
+            block = blocks[block].next_block;
+        }
+        position += run;
+        length -= run;
+    }
+    return true;
+}
+
+bool COWFileSystem::export_archive(std::ostream& out, const ExportOptions& options, ExportStats* stats) {
+    ExportStats result;
+
+    std::vector<ExportMember> members;
+    for (const auto& inode : inodes) {
+        if (!inode.is_used) {
+            continue;
+        }
+        // Un archivo creado y nunca escrito se exporta vacio para no perder su nombre
+        if (inode.version_history.empty()) {
+            members.push_back(ExportMember{&inode, NO_VERSION, 0, inode.filename});
+            continue;
+        }
+        size_t first = options.scope == ExportScope::HEAD ? inode.version_history.size() - 1 : 0;
+        for (size_t i = first; i < inode.version_history.size(); ++i) {
+            // La posicion 0 esta en la version mas reciente con delta_start 0
+            size_t source = i;
+            while (source > 0 && inode.version_history[source].delta_start > 0) {
+                source--;
+            }
+            ExportMember member{&inode, i, 0, inode.filename};
+            if (inode.version_history[i].size > 0) {
+                member.first_block = inode.version_history[source].block_index;
+            }
+            if (options.scope == ExportScope::ALL_VERSIONS) {
+                member.name += "@v" + std::to_string(inode.version_history[i].version_number);
+            }
+            members.push_back(std::move(member));
+        }
+    }
+    std::stable_sort(members.begin(), members.end(), [](const ExportMember& a, const ExportMember& b) {
+        return a.first_block < b.first_block;
+    });
+
+    // La ventana admite al menos un bloque completo
+    const size_t window = std::max(options.window_bytes, BLOCK_SIZE);
+    std::vector<uint8_t> buffer(window);
+    std::vector<uint8_t> scratch(BLOCK_SIZE);
+    std::vector<ChainExtent> extents;
+    std::vector<size_t> order;
+    size_t last_block = 0;
+
+    const time_t export_time = std::time(nullptr);
+    for (const auto& member : members) {
+        if (member.version_index == NO_VERSION) {
+            // Sin version no hay fecha de modificacion: se usa la de la exportacion
+            write_member_header(out, member.name, 0, export_time);
+            result.entries++;
+            continue;
+        }
+        if (!version_extents(*member.inode, member.version_index, extents)) {
+            return false;
+        }
+        const VersionInfo& version = member.inode->version_history[member.version_index];
+        write_member_header(out, member.name, version.size, parse_timestamp(version.timestamp));
+
+        size_t next = 0;
+        while (next < extents.size()) {
+            size_t window_start = extents[next].position;
+            size_t end = next;
+            while (end < extents.size() &&
+                   extents[end].position + extents[end].length - window_start <= window) {
+                end++;
+            }
+
+            // Lecturas en orden fisico; cada trozo va a su posicion logica
+            order.resize(end - next);
+            std::iota(order.begin(), order.end(), next);
+            std::sort(order.begin(), order.end(), [&extents](size_t a, size_t b) {
+                return extents[a].block < extents[b].block;
+            });
+            for (size_t index : order) {
+                const ChainExtent& extent = extents[index];
+                // Recorrido de toda la imagen: no carga bloques desalojados ni
+                // altera el reloj de la cache de los que estan en memoria
+                const uint8_t* data = peek_block(extent.block, scratch.data());
+                if (!verify_block(extent.block, data)) {
+                    return false;
+                }
+                if (extent.block < last_block) {
+                    result.backward_jumps++;
+                }
+                last_block = extent.block;
+                std::memcpy(buffer.data() + (extent.position - window_start),
+                            data + extent.block_offset, extent.length);
+                result.block_reads++;
+            }
+
+            size_t window_size = extents[end - 1].position + extents[end - 1].length - window_start;
+            out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(window_size));
+            next = end;
+        }
+        write_tar_padding(out, version.size);
+        result.entries++;
+        result.content_bytes += version.size;
+    }
+
+    // Fin del archivo: dos bloques a cero
+    static const char end_of_archive[2 * TAR_BLOCK] = {};
+    out.write(end_of_archive, sizeof(end_of_archive));
+    out.flush();
+    if (stats) {
+        *stats = result;
+    }
+    if (!out) {
+        COWFS_LOG_ERROR("export: Error writing the archive");
+        return false;
+    }
+    COWFS_LOG_INFO("export: " << result.entries << " entries, " << result.content_bytes << " bytes, "
+                   << result.backward_jumps << " backward jumps");
+    return true;
+}
+
+} // namespace cowfs
@@ -0,0 +1,198 @@
+#include "cowfs_import.hpp"
+#include "cowfs_checksum.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace cowfs {
+
+namespace {
+
+namespace fs_host = std::filesystem;
+
+// Archivos preparados por los lectores y pendientes de dar de alta. Los
+// lectores se bloquean cuando el contenido en cola supera max_bytes, para
+// que la memoria no crezca si la importacion va mas lenta que la lectura
+struct PreparedQueue {
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<ImportedFile> files;
+    size_t queued_bytes = 0;
+    size_t max_bytes = 0;
+    size_t readers_left = 0;
+    std::vector<std::string> failures;
+};
+
+bool read_host_file(const fs_host::path& path, std::vector<uint8_t>& content) {
+    std::error_code ec;
+    uintmax_t size = fs_host::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    content.resize(static_cast<size_t>(size));
+    return size == 0 || static_cast<bool>(in.read(reinterpret_cast<char*>(content.data()),
+                                                  static_cast<std::streamsize>(size)));
+}
+
+void reader(const std::vector<fs_host::path>& paths, const fs_host::path& root,
+            std::atomic<size_t>& next, PreparedQueue& queue) {
+    for (size_t i = next++; i < paths.size(); i = next++) {
+        ImportedFile file;
+        file.name = paths[i].lexically_relative(root).generic_string();
+        if (!read_host_file(paths[i], file.content)) {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.failures.push_back(file.name + ": read error");
+            continue;
+        }
+        prepare_import(file);
+
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.not_full.wait(lock, [&queue]() {
+            return queue.queued_bytes < queue.max_bytes || queue.files.empty();
+        });
+        queue.queued_bytes += file.content.size();
+        queue.files.push_back(std::move(file));
+        lock.unlock();
+        queue.not_empty.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.readers_left--;
+    queue.not_empty.notify_all();
+}
+
+const char* status_reason(ImportStatus status) {
+    switch (status) {
+        case ImportStatus::INVALID_NAME: return "invalid name";
+        case ImportStatus::NO_SPACE: return "no free inodes or blocks";
+        default: return "not imported";
+    }
+}
+
+} // namespace
+
+void prepare_import(ImportedFile& file) {
+    static const uint8_t zeros[BLOCK_SIZE] = {};
+    const size_t size = file.content.size();
+    file.merkle = merkle_build(file.content.data(), size);
+    file.checksums.clear();
+    file.checksums.reserve((size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    for (size_t offset = 0; offset < size; offset += BLOCK_SIZE) {
+        size_t length = std::min(BLOCK_SIZE, size - offset);
+        // El CRC cubre el bloque completo, con el relleno a ceros del final
+        uint32_t crc = crc32c(file.content.data() + offset, length);
+        if (length < BLOCK_SIZE) {
+            crc = crc32c(zeros, BLOCK_SIZE - length, crc);
+        }
+        file.checksums.push_back(crc);
+    }
+}
+
+ImportReport import_directory(COWFileSystem& fs, std::mutex& fs_mutex, const std::string& root,
+                              const ImportOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    ImportReport report;
+
+    // Orden estable de los nombres para que dos importaciones del mismo arbol
+    // recorran los archivos igual
+    std::vector<fs_host::path> paths;
+    std::error_code ec;
+    fs_host::recursive_directory_iterator it(root, fs_host::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs_host::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code type_ec;
+        if (it->is_regular_file(type_ec)) {
+            paths.push_back(it->path());
+        }
+    }
+    if (ec) {
+        COWFS_LOG_ERROR("import: Could not list " << root << ": " << ec.message());
+        report.failures.push_back(root + ": " + ec.message());
+        report.files_failed++;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    const size_t batch_files = std::max<size_t>(options.batch_files, 1);
+    const size_t batch_bytes = std::max<size_t>(options.batch_bytes, BLOCK_SIZE);
+    size_t thread_count = options.threads ? options.threads : std::thread::hardware_concurrency();
+    thread_count = std::max<size_t>(1, std::min(thread_count, paths.size()));
+
+    PreparedQueue queue;
+    queue.max_bytes = 2 * batch_bytes;
+    queue.readers_left = thread_count;
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> readers;
+    const fs_host::path root_path(root);
+    for (size_t i = 0; i < thread_count && !paths.empty(); ++i) {
+        readers.emplace_back(reader, std::cref(paths), std::cref(root_path), std::ref(next), std::ref(queue));
+    }
+
+    std::vector<ImportedFile> batch;
+    size_t pending_bytes = 0;
+    auto commit = [&]() {
+        if (batch.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(fs_mutex);
+            fs.import_files(batch);
+        }
+        for (const auto& file : batch) {
+            if (file.status == ImportStatus::IMPORTED) {
+                report.files_imported++;
+                report.bytes_imported += file.content.size();
+            } else if (file.status == ImportStatus::EXISTS) {
+                report.files_existing++;
+            } else {
+                report.files_failed++;
+                report.failures.push_back(file.name + ": " + status_reason(file.status));
+            }
+        }
+        report.batches++;
+        batch.clear();
+        pending_bytes = 0;
+    };
+
+    while (!paths.empty()) {
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            queue.not_empty.wait(lock, [&queue]() { return !queue.files.empty() || queue.readers_left == 0; });
+            if (queue.files.empty()) {
+                break;
+            }
+            while (!queue.files.empty() && batch.size() < batch_files && pending_bytes < batch_bytes) {
+                pending_bytes += queue.files.front().content.size();
+                queue.queued_bytes -= queue.files.front().content.size();
+                batch.push_back(std::move(queue.files.front()));
+                queue.files.pop_front();
+            }
+        }
+        queue.not_full.notify_all();
+        if (batch.size() >= batch_files || pending_bytes >= batch_bytes) {
+            commit();
+        }
+    }
+    commit();
+
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    report.files_failed += queue.failures.size();
+    report.failures.insert(report.failures.end(), queue.failures.begin(), queue.failures.end());
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    COWFS_LOG_INFO("import: " << report.files_imported << " files, " << report.bytes_imported << " bytes in "
+                   << report.batches << " batches");
+    return report;
+}
+
+} // namespace cowfs
@@ -0,0 +1,54 @@
+#ifndef COWFS_IMPORT_HPP
+#define COWFS_IMPORT_HPP
+
+#include "cowfs.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Importacion masiva de un arbol de directorios del host. Un grupo de hilos
+// lee los archivos y calcula su arbol de Merkle y los CRC32C de sus bloques;
+// el hilo que llama agrupa los archivos preparados en lotes y los da de alta
+// con COWFileSystem::import_files(), tomando el mutex una vez por lote.
+
+namespace cowfs {
+
+struct ImportOptions {
+    size_t threads = 0;                      // Hilos lectores; 0 para uno por nucleo
+    size_t batch_files = 256;                // Archivos por llamada a import_files()
+    // Contenido por llamada a import_files(); con lotes pequenos el contenido
+    // sigue en cache cuando se copia a los bloques
+    size_t batch_bytes = 1024 * 1024;
+};
+
+struct ImportReport {
+    size_t files_imported = 0;
+    size_t files_existing = 0;     // Ya habia un archivo con ese nombre
+    size_t files_failed = 0;       // Error de lectura, nombre invalido o sin espacio
+    uint64_t bytes_imported = 0;
+    size_t batches = 0;
+    double seconds = 0;
+    std::vector<std::string> failures;   // Ruta relativa y motivo de cada fallo
+
+    double files_per_second() const { return seconds > 0 ? files_imported / seconds : 0; }
+    double megabytes_per_second() const {
+        return seconds > 0 ? static_cast<double>(bytes_imported) / (1024.0 * 1024.0) / seconds : 0;
+    }
+};
+
+// Calcula el arbol de Merkle y los CRC32C de los bloques de file.content
+void prepare_import(ImportedFile& file);
+
+/**
+ * @brief Importa todos los archivos regulares bajo root
+ *
+ * Cada archivo se crea con su ruta relativa a root, con '/' como separador,
+ * como nombre y con una sola version.
+ * @param fs_mutex Mutex que protege todas las llamadas a fs
+ */
+ImportReport import_directory(COWFileSystem& fs, std::mutex& fs_mutex, const std::string& root,
+                              const ImportOptions& options = ImportOptions());
+
+} // namespace cowfs
+
+#endif // COWFS_IMPORT_HPP
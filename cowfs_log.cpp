@@ -0,0 +1,48 @@
+#include "cowfs_log.hpp"
+#include <iostream>
+#include <mutex>
+
+namespace cowfs {
+
+namespace {
+
+std::mutex sink_mutex;
+LogSink current_sink;
+
+void default_sink(LogLevel level, const std::string& message) {
+    if (level >= LogLevel::WARN) {
+        std::cerr << message << std::endl;
+    } else {
+        std::cout << message << std::endl;
+    }
+}
+
+} // namespace
+
+void set_log_level(LogLevel level) {
+    detail::runtime_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel get_log_level() {
+    return static_cast<LogLevel>(detail::runtime_log_level.load(std::memory_order_relaxed));
+}
+
+void set_log_sink(LogSink sink) {
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    current_sink = std::move(sink);
+}
+
+namespace detail {
+
+void log_write(LogLevel level, const std::string& message) {
+    std::lock_guard<std::mutex> lock(sink_mutex);
+    if (current_sink) {
+        current_sink(level, message);
+    } else {
+        default_sink(level, message);
+    }
+}
+
+} // namespace detail
+
+} // namespace cowfs
@@ -0,0 +1,84 @@
+#ifndef COWFS_LOG_HPP
+#define COWFS_LOG_HPP
+
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <string>
+
+// Niveles de log en tiempo de compilacion. Las llamadas por debajo de
+// COWFS_LOG_LEVEL se eliminan por completo al compilar.
+#define COWFS_LOG_LEVEL_TRACE 0
+#define COWFS_LOG_LEVEL_DEBUG 1
+#define COWFS_LOG_LEVEL_INFO  2
+#define COWFS_LOG_LEVEL_WARN  3
+#define COWFS_LOG_LEVEL_ERROR 4
+#define COWFS_LOG_LEVEL_OFF   5
+
+#ifndef COWFS_LOG_LEVEL
+#ifdef NDEBUG
+#define COWFS_LOG_LEVEL COWFS_LOG_LEVEL_WARN
+#else
+#define COWFS_LOG_LEVEL COWFS_LOG_LEVEL_TRACE
+#endif
+#endif
+
+namespace cowfs {
+
+enum class LogLevel {
+    TRACE = COWFS_LOG_LEVEL_TRACE,
+    DEBUG = COWFS_LOG_LEVEL_DEBUG,
+    INFO = COWFS_LOG_LEVEL_INFO,
+    WARN = COWFS_LOG_LEVEL_WARN,
+    ERROR = COWFS_LOG_LEVEL_ERROR,
+    OFF = COWFS_LOG_LEVEL_OFF
+};
+
+using LogSink = std::function<void(LogLevel level, const std::string& message)>;
+
+/**
+ * @brief Cambia el nivel minimo de log en tiempo de ejecucion
+ *
+ * Solo afecta a los mensajes que sobrevivieron al filtro de COWFS_LOG_LEVEL.
+ */
+void set_log_level(LogLevel level);
+LogLevel get_log_level();
+
+/**
+ * @brief Reemplaza el destino de los mensajes de log
+ * @param sink Funcion que recibe cada mensaje; nullptr restaura el destino por
+ *             defecto (std::cout para TRACE..INFO, std::cerr para WARN y ERROR)
+ */
+void set_log_sink(LogSink sink);
+
+namespace detail {
+
+inline std::atomic<int> runtime_log_level{COWFS_LOG_LEVEL_TRACE};
+
+inline bool log_enabled(LogLevel level) {
+    return static_cast<int>(level) >= runtime_log_level.load(std::memory_order_relaxed);
+}
+
+void log_write(LogLevel level, const std::string& message);
+
+} // namespace detail
+
+} // namespace cowfs
+
+#define COWFS_LOG_AT(level_value, level, expr)                                  \
+    do {                                                                        \
+        if ((level_value) >= COWFS_LOG_LEVEL &&                                 \
+            ::cowfs::detail::log_enabled(level)) {                              \
+            std::ostringstream cowfs_log_stream_;                               \
+            cowfs_log_stream_ << expr;                                          \
+            ::cowfs::detail::log_write(level, cowfs_log_stream_.str());         \
+        }                                                                       \
+    } while (0)
+
+#define COWFS_LOG_TRACE(expr) COWFS_LOG_AT(COWFS_LOG_LEVEL_TRACE, ::cowfs::LogLevel::TRACE, expr)
+#define COWFS_LOG_DEBUG(expr) COWFS_LOG_AT(COWFS_LOG_LEVEL_DEBUG, ::cowfs::LogLevel::DEBUG, expr)
+#define COWFS_LOG_INFO(expr)  COWFS_LOG_AT(COWFS_LOG_LEVEL_INFO, ::cowfs::LogLevel::INFO, expr)
+#define COWFS_LOG_WARN(expr)  COWFS_LOG_AT(COWFS_LOG_LEVEL_WARN, ::cowfs::LogLevel::WARN, expr)
+#define COWFS_LOG_ERROR(expr) COWFS_LOG_AT(COWFS_LOG_LEVEL_ERROR, ::cowfs::LogLevel::ERROR, expr)
+
+#endif // COWFS_LOG_HPP
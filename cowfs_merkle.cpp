@@ -0,0 +1,244 @@
+#include "cowfs_merkle.hpp"
+#include "cowfs.hpp"
+#include "cowfs_checksum.hpp"
+#include <algorithm>
+#include <atomic>
+
+namespace cowfs {
+
+namespace {
+
+// Semillas distintas para hojas, nodos internos y digest, para que un tipo
+// de hash nunca coincida con otro por construccion
+constexpr uint64_t LEAF_SEED = 0x4C454146;
+constexpr uint64_t INNER_SEED = 0x494E4E45;
+constexpr uint64_t DIGEST_SEED = 0x44494745;
+
+size_t leaf_count(size_t size) {
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// Altura minima para cubrir todas las hojas (0: la raiz es una hoja)
+unsigned tree_height(size_t size) {
+    unsigned height = 0;
+    while ((size_t(1) << height) < leaf_count(size)) {
+        height++;
+    }
+    return height;
+}
+
+uint64_t node_hash(const MerkleTree& node) {
+    return node ? node->hash : 0;
+}
+
+// Los arboles se construyen tambien en los hilos de import_files()
+std::atomic<size_t> live_node_bytes{0};
+
+struct NodeDeleter {
+    void operator()(const MerkleNode* node) const {
+        live_node_bytes.fetch_sub(sizeof(MerkleNode), std::memory_order_relaxed);
+        delete node;
+    }
+};
+
+MerkleTree make_node(uint64_t hash, MerkleTree left, MerkleTree right) {
+    MerkleTree node(new MerkleNode{hash, std::move(left), std::move(right)}, NodeDeleter());
+    live_node_bytes.fetch_add(sizeof(MerkleNode), std::memory_order_relaxed);
+    return node;
+}
+
+MerkleTree make_leaf(const uint8_t* content, size_t size, size_t leaf) {
+    size_t offset = leaf * BLOCK_SIZE;
+    size_t length = std::min(BLOCK_SIZE, size - offset);
+    return make_node(hash64(content + offset, length, LEAF_SEED), nullptr, nullptr);
+}
+
+MerkleTree make_inner(MerkleTree left, MerkleTree right) {
+    if (!left && !right) {
+        return nullptr;
+    }
+    uint64_t children[2] = {node_hash(left), node_hash(right)};
+    return make_node(hash64(children, sizeof(children), INNER_SEED), std::move(left), std::move(right));
+}
+
+MerkleTree build_range(const uint8_t* content, size_t size, unsigned level, size_t index) {
+    if ((index << level) >= leaf_count(size)) {
+        return nullptr;
+    }
+    if (level == 0) {
+        return make_leaf(content, size, index);
+    }
+    return make_inner(build_range(content, size, level - 1, 2 * index),
+                      build_range(content, size, level - 1, 2 * index + 1));
+}
+
+// Nodo del arbol anterior que cubre el mismo rango que el nodo nuevo. Si el
+// arbol anterior es mas bajo, los nodos del nuevo por encima de su raiz en el
+// extremo izquierdo no tienen equivalente (valid = false); los de la derecha
+// cubren hojas vacias en el anterior
+struct PreviousNode {
+    MerkleTree node;
+    bool valid;
+};
+
+struct UpdateContext {
+    const uint8_t* content;
+    size_t size;
+    size_t leaves;
+    size_t changed_first;   // Rango de hojas [changed_first, changed_last) a recalcular
+    size_t changed_last;
+    MerkleTree previous_root;
+    unsigned previous_height;
+};
+
+PreviousNode previous_child(const UpdateContext& context, const PreviousNode& parent,
+                            unsigned level, bool right) {
+    if (parent.valid) {
+        return {parent.node ? (right ? parent.node->right : parent.node->left) : nullptr, true};
+    }
+    if (right) {
+        return {nullptr, true};
+    }
+    if (level - 1 == context.previous_height) {
+        return {context.previous_root, true};
+    }
+    return {nullptr, false};
+}
+
+MerkleTree update_range(const UpdateContext& context, const PreviousNode& previous,
+                        unsigned level, size_t index) {
+    size_t first = index << level;
+    size_t last = first + (size_t(1) << level);
+    if (first >= context.leaves) {
+        return nullptr;
+    }
+    if (previous.valid && (last <= context.changed_first || first >= context.changed_last)) {
+        return previous.node;
+    }
+    if (level == 0) {
+        return make_leaf(context.content, context.size, index);
+    }
+    return make_inner(update_range(context, previous_child(context, previous, level, false), level - 1, 2 * index),
+                      update_range(context, previous_child(context, previous, level, true), level - 1, 2 * index + 1));
+}
+
+// Nodo de un arbol en un rango, con la misma convencion que PreviousNode
+struct DiffSide {
+    MerkleTree node;
+    bool valid;
+    MerkleTree root;
+    unsigned height;
+
+    DiffSide child(unsigned level, bool right) const {
+        if (valid) {
+            return {node ? (right ? node->right : node->left) : nullptr, true, root, height};
+        }
+        if (right) {
+            return {nullptr, true, root, height};
+        }
+        if (level - 1 == height) {
+            return {root, true, root, height};
+        }
+        return {nullptr, false, root, height};
+    }
+};
+
+void diff_range(const DiffSide& a, const DiffSide& b, unsigned level, size_t index, size_t max_size,
+                std::vector<ByteRange>& ranges, size_t& comparisons) {
+    if (a.valid && b.valid) {
+        comparisons++;
+        if (node_hash(a.node) == node_hash(b.node)) {
+            return;
+        }
+    }
+    if (level == 0) {
+        size_t offset = index * BLOCK_SIZE;
+        size_t length = std::min(BLOCK_SIZE, max_size - offset);
+        if (!ranges.empty() && ranges.back().offset + ranges.back().length == offset) {
+            ranges.back().length += length;
+        } else {
+            ranges.push_back(ByteRange{offset, length});
+        }
+        return;
+    }
+    diff_range(a.child(level, false), b.child(level, false), level - 1, 2 * index, max_size, ranges, comparisons);
+    diff_range(a.child(level, true), b.child(level, true), level - 1, 2 * index + 1, max_size, ranges, comparisons);
+}
+
+} // namespace
+
+size_t merkle_node_bytes() {
+    return live_node_bytes.load(std::memory_order_relaxed);
+}
+
+MerkleTree merkle_build(const uint8_t* content, size_t size) {
+    return build_range(content, size, tree_height(size), 0);
+}
+
+MerkleTree merkle_update(const MerkleTree& previous, size_t previous_size,
+                         const uint8_t* content, size_t size,
+                         size_t changed_begin, size_t changed_end) {
+    if (!previous || previous_size == 0) {
+        return merkle_build(content, size);
+    }
+
+    UpdateContext context;
+    context.content = content;
+    context.size = size;
+    context.leaves = leaf_count(size);
+    context.changed_first = changed_begin / BLOCK_SIZE;
+    if (size == previous_size) {
+        context.changed_last = leaf_count(std::max(changed_begin, changed_end));
+    } else {
+        // El sufijo comun se desplaza: cambian todas las hojas desde changed_begin
+        context.changed_last = std::max(context.leaves, leaf_count(previous_size));
+    }
+    context.previous_root = previous;
+    context.previous_height = tree_height(previous_size);
+
+    unsigned height = tree_height(size);
+    PreviousNode root{nullptr, false};
+    if (height <= context.previous_height) {
+        root = {previous, true};
+        for (unsigned level = context.previous_height; level > height; --level) {
+            root.node = root.node ? root.node->left : nullptr;
+        }
+    } else {
+        root = {nullptr, false};
+    }
+    return update_range(context, root, height, 0);
+}
+
+uint64_t merkle_digest(const MerkleTree& tree, size_t size) {
+    uint64_t values[2] = {node_hash(tree), static_cast<uint64_t>(size)};
+    return hash64(values, sizeof(values), DIGEST_SEED);
+}
+
+std::vector<ByteRange> merkle_diff(const MerkleTree& a, size_t size_a,
+                                   const MerkleTree& b, size_t size_b,
+                                   size_t* comparisons) {
+    unsigned height_a = tree_height(size_a);
+    unsigned height_b = tree_height(size_b);
+    unsigned height = std::max(height_a, height_b);
+
+    // El arbol mas bajo se ve desde la altura comun como en merkle_update
+    auto side = [height](const MerkleTree& root, unsigned own_height) {
+        if (own_height == height) {
+            return DiffSide{root, true, root, own_height};
+        }
+        return DiffSide{nullptr, false, root, own_height};
+    };
+
+    std::vector<ByteRange> ranges;
+    size_t compared = 0;
+    size_t max_size = std::max(size_a, size_b);
+    if (max_size > 0) {
+        diff_range(side(a, height_a), side(b, height_b), height, 0, max_size, ranges, compared);
+    }
+    if (comparisons) {
+        *comparisons = compared;
+    }
+    return ranges;
+}
+
+} // namespace cowfs
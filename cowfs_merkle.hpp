@@ -0,0 +1,68 @@
+#ifndef COWFS_MERKLE_HPP
+#define COWFS_MERKLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Arbol de Merkle sobre el contenido logico de una version, en hojas de
+// BLOCK_SIZE bytes. El arbol es binario completo sobre rangos de hojas
+// alineados a potencias de dos, asi que dos versiones (o dos imagenes) con
+// el mismo contenido en un rango comparten el mismo subarbol y el mismo hash.
+// Los nodos son inmutables y se comparten entre versiones con shared_ptr.
+
+namespace cowfs {
+
+struct MerkleNode {
+    uint64_t hash;
+    std::shared_ptr<const MerkleNode> left;
+    std::shared_ptr<const MerkleNode> right;
+};
+
+// Un arbol nulo representa un rango vacio (hash 0)
+using MerkleTree = std::shared_ptr<const MerkleNode>;
+
+struct ByteRange {
+    size_t offset;
+    size_t length;
+};
+
+/**
+ * @brief Construye el arbol de un contenido completo
+ */
+MerkleTree merkle_build(const uint8_t* content, size_t size);
+
+/**
+ * @brief Construye el arbol de un contenido nuevo reutilizando los
+ *        subarboles del anterior cuyas hojas no cambiaron
+ * @param changed_begin Primer byte que puede diferir del contenido anterior
+ * @param changed_end Fin (exclusivo) de los bytes que pueden diferir; solo
+ *        se usa si el tamano no cambia, si no todo lo posterior a
+ *        changed_begin se considera cambiado
+ */
+MerkleTree merkle_update(const MerkleTree& previous, size_t previous_size,
+                         const uint8_t* content, size_t size,
+                         size_t changed_begin, size_t changed_end);
+
+// Bytes de los nodos vivos de todos los arboles del proceso. Se lleva al
+// crear y destruir cada nodo, sin recorrer los arboles
+size_t merkle_node_bytes();
+
+// Hash de un contenido: raiz del arbol combinada con su tamano
+uint64_t merkle_digest(const MerkleTree& tree, size_t size);
+
+/**
+ * @brief Rangos de bytes en los que difieren dos contenidos
+ *
+ * Solo desciende por los subarboles con hashes distintos: O(d log n)
+ * comparaciones para d hojas distintas.
+ * @param comparisons Si no es nulo, recibe el numero de nodos comparados
+ */
+std::vector<ByteRange> merkle_diff(const MerkleTree& a, size_t size_a,
+                                   const MerkleTree& b, size_t size_b,
+                                   size_t* comparisons = nullptr);
+
+} // namespace cowfs
+
+#endif // COWFS_MERKLE_HPP
@@ -3,9 +3,69 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <algorithm>
+#include <map>
 
 namespace cowfs {
 
+namespace {
+
+// Copia de los datos de un archivo tomada antes de formatear, para que los
+// hilos de formateo no toquen el sistema de archivos (que no es thread-safe)
+struct FileSnapshot {
+    std::string name;
+    FileStatus status;
+    std::vector<VersionInfo> version_history;
+    FileAccessStats access;
+};
+
+// Numero minimo de archivos por shard para que valga la pena lanzar un hilo
+constexpr size_t MIN_FILES_PER_SHARD = 64;
+
+void render_file(std::ostream& json_output, const FileSnapshot& file, bool is_last) {
+    json_output << "      {\n";
+    json_output << "        \"name\": \"" << file.name << "\",\n";
+    json_output << "        \"size\": " << file.status.current_size << ",\n";
+    json_output << "        \"version_count\": " << file.status.current_version << ",\n";
+    json_output << "        \"is_open\": " << (file.status.is_open ? "true" : "false") << ",\n";
+
+    json_output << "        \"access\": {\n";
+    json_output << "          \"reads\": " << file.access.reads << ",\n";
+    json_output << "          \"read_bytes\": " << file.access.read_bytes << ",\n";
+    json_output << "          \"writes\": " << file.access.writes << ",\n";
+    json_output << "          \"write_bytes\": " << file.access.write_bytes << ",\n";
+    json_output << "          \"last_access_ms\": " << file.access.last_access_ms << ",\n";
+    json_output << "          \"heat\": " << file.access.heat << "\n";
+    json_output << "        },\n";
+
+    json_output << "        \"version_history\": [\n";
+    const auto& version_history = file.version_history;
+    for (size_t j = 0; j < version_history.size(); ++j) {
+        const auto& version = version_history[j];
+        json_output << "          {\n";
+        json_output << "            \"version_number\": " << version.version_number << ",\n";
+        json_output << "            \"block_index\": " << version.block_index << ",\n";
+        json_output << "            \"size\": " << version.size << ",\n";
+        json_output << "            \"timestamp\": \"" << version.timestamp << "\"\n";
+        json_output << "          }" << (j < version_history.size() - 1 ? "," : "") << "\n";
+    }
+    json_output << "        ]\n";
+
+    json_output << "      }" << (is_last ? "" : ",") << "\n";
+}
+
+// Formatea los archivos [begin, end) en un buffer propio del shard
+std::string render_shard(const std::vector<FileSnapshot>& snapshots, size_t begin, size_t end) {
+    std::ostringstream shard_output;
+    for (size_t i = begin; i < end; ++i) {
+        render_file(shard_output, snapshots[i], i == snapshots.size() - 1);
+    }
+    return shard_output.str();
+}
+
+} // namespace
+
 std::string MetadataManager::generate_metadata_json(COWFileSystem& fs) {
     std::stringstream json_output;
     json_output << "{\n";
@@ -14,36 +74,58 @@ std::string MetadataManager::generate_metadata_json(COWFileSystem& fs) {
     
     std::vector<std::string> files;
     fs.list_files(files);
+
+    // Se toma antes de abrir los archivos; open() no cuenta como acceso
+    std::map<std::string, FileAccessStats> access;
+    for (auto& file_access : fs.file_access_stats()) {
+        access[file_access.name] = file_access;
+    }
     
-    json_output << "    \"files\": [\n";
-    for (size_t i = 0; i < files.size(); ++i) {
-        const auto& filename = files[i];
+    // Fase secuencial: recolectar los datos de cada archivo
+    std::vector<FileSnapshot> snapshots;
+    snapshots.reserve(files.size());
+    for (const auto& filename : files) {
         fd_t fd = fs.open(filename, FileMode::READ);
         if (fd >= 0) {
-            auto status = fs.get_file_status(fd);
-            json_output << "      {\n";
-            json_output << "        \"name\": \"" << filename << "\",\n";
-            json_output << "        \"size\": " << status.current_size << ",\n";
-            json_output << "        \"version_count\": " << status.current_version << ",\n";
-            json_output << "        \"is_open\": " << (status.is_open ? "true" : "false") << ",\n";
-            
-            json_output << "        \"version_history\": [\n";
-            auto version_history = fs.get_version_history(fd);
-            for (size_t j = 0; j < version_history.size(); ++j) {
-                const auto& version = version_history[j];
-                json_output << "          {\n";
-                json_output << "            \"version_number\": " << version.version_number << ",\n";
-                json_output << "            \"block_index\": " << version.block_index << ",\n";
-                json_output << "            \"size\": " << version.size << ",\n";
-                json_output << "            \"timestamp\": \"" << version.timestamp << "\"\n";
-                json_output << "          }" << (j < version_history.size() - 1 ? "," : "") << "\n";
+            FileSnapshot snapshot;
+            snapshot.name = filename;
+            snapshot.status = fs.get_file_status(fd);
+            snapshot.version_history = fs.get_version_history(fd);
+            auto it = access.find(filename);
+            if (it != access.end()) {
+                snapshot.access = it->second;
             }
-            json_output << "        ]\n";
-            
-            json_output << "      }" << (i < files.size() - 1 ? "," : "") << "\n";
+            snapshots.push_back(std::move(snapshot));
             fs.close(fd);
         }
     }
+
+    // Fase paralela: cada hilo formatea un rango contiguo de archivos y los
+    // buffers se concatenan en orden
+    size_t hw_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t shard_count = std::min(hw_threads,
+                                  std::max<size_t>(1, snapshots.size() / MIN_FILES_PER_SHARD));
+    size_t shard_size = (snapshots.size() + shard_count - 1) / shard_count;
+
+    std::vector<std::string> shard_buffers(shard_count);
+    std::vector<std::thread> workers;
+    for (size_t s = 1; s < shard_count; ++s) {
+        size_t begin = std::min(s * shard_size, snapshots.size());
+        size_t end = std::min(begin + shard_size, snapshots.size());
+        workers.emplace_back([&snapshots, &shard_buffers, s, begin, end]() {
+            shard_buffers[s] = render_shard(snapshots, begin, end);
+        });
+    }
+    // El hilo actual se encarga del primer shard
+    shard_buffers[0] = render_shard(snapshots, 0, std::min(shard_size, snapshots.size()));
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    json_output << "    \"files\": [\n";
+    for (const auto& buffer : shard_buffers) {
+        json_output << buffer;
+    }
     json_output << "    ]\n";
     json_output << "  }\n";
     json_output << "}";
@@ -0,0 +1,192 @@
+#include "cowfs_recorder.hpp"
+#include <cstring>
+
+namespace cowfs {
+
+namespace {
+
+const char TRACE_MAGIC[8] = {'C', 'O', 'W', 'F', 'S', 'W', 'L', 'T'};
+constexpr uint64_t TRACE_FORMAT_VERSION = 1;
+
+void write_varint(std::ostream& out, uint64_t value) {
+    char bytes[10];
+    size_t length = 0;
+    while (value >= 0x80) {
+        bytes[length++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = static_cast<char>(value);
+    out.write(bytes, static_cast<std::streamsize>(length));
+}
+
+void write_signed(std::ostream& out, int64_t value) {
+    write_varint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void write_fixed(std::ostream& out, uint64_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool read_varint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::istream::traits_type::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool read_signed(std::istream& in, int64_t& value) {
+    uint64_t raw = 0;
+    if (!read_varint(in, raw)) {
+        return false;
+    }
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+}
+
+bool read_fixed(std::istream& in, uint64_t& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+} // namespace
+
+const char* trace_op_name(TraceOp op) {
+    switch (op) {
+        case TraceOp::CREATE: return "create";
+        case TraceOp::OPEN: return "open";
+        case TraceOp::READ: return "read";
+        case TraceOp::WRITE: return "write";
+        case TraceOp::CLOSE: return "close";
+        case TraceOp::ROLLBACK: return "rollback_to_version";
+        case TraceOp::GARBAGE_COLLECT: return "garbage_collect";
+    }
+    return "unknown";
+}
+
+uint64_t content_hash(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+WorkloadRecorder::WorkloadRecorder(const std::string& path, uint64_t disk_size)
+    : out(path, std::ios::binary | std::ios::trunc), start(std::chrono::steady_clock::now()) {
+    if (out.is_open()) {
+        out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        write_fixed(out, TRACE_FORMAT_VERSION);
+        write_fixed(out, disk_size);
+    }
+}
+
+WorkloadRecorder::~WorkloadRecorder() {
+    out.flush();
+}
+
+void WorkloadRecorder::record(TraceRecord& record) {
+    if (!out.is_open()) {
+        return;
+    }
+    record.timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    out.put(static_cast<char>(record.op));
+    // Los timestamps se guardan como diferencia con el registro anterior
+    write_varint(out, record.timestamp_ns - last_timestamp_ns);
+    last_timestamp_ns = record.timestamp_ns;
+    write_signed(out, record.fd);
+    write_signed(out, record.result);
+
+    switch (record.op) {
+        case TraceOp::CREATE:
+        case TraceOp::OPEN:
+            write_varint(out, record.name.size());
+            out.write(record.name.data(), static_cast<std::streamsize>(record.name.size()));
+            if (record.op == TraceOp::OPEN) {
+                write_varint(out, record.mode);
+            }
+            break;
+        case TraceOp::READ:
+            write_varint(out, record.size);
+            write_varint(out, record.offset);
+            break;
+        case TraceOp::WRITE:
+            write_varint(out, record.size);
+            write_varint(out, record.offset);
+            write_varint(out, record.delta_size);
+            write_fixed(out, record.content_hash);
+            break;
+        case TraceOp::ROLLBACK:
+            write_varint(out, record.version);
+            break;
+        case TraceOp::CLOSE:
+        case TraceOp::GARBAGE_COLLECT:
+            break;
+    }
+    records++;
+}
+
+TraceReader::TraceReader(const std::string& path) : in(path, std::ios::binary) {
+    char magic[sizeof(TRACE_MAGIC)];
+    uint64_t format_version = 0;
+    valid = in.read(magic, sizeof(magic)) && std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0 &&
+            read_fixed(in, format_version) && format_version == TRACE_FORMAT_VERSION &&
+            read_fixed(in, image_size);
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    if (!valid) {
+        return false;
+    }
+    int op = in.get();
+    if (op == std::istream::traits_type::eof() ||
+        op < static_cast<int>(TraceOp::CREATE) || op > static_cast<int>(TraceOp::GARBAGE_COLLECT)) {
+        return false;
+    }
+    record = TraceRecord(static_cast<TraceOp>(op));
+
+    uint64_t delta_ns = 0;
+    if (!read_varint(in, delta_ns) || !read_signed(in, record.fd) || !read_signed(in, record.result)) {
+        return false;
+    }
+    last_timestamp_ns += delta_ns;
+    record.timestamp_ns = last_timestamp_ns;
+
+    switch (record.op) {
+        case TraceOp::CREATE:
+        case TraceOp::OPEN: {
+            uint64_t length = 0;
+            if (!read_varint(in, length) || length > 4096) {
+                return false;
+            }
+            record.name.resize(length);
+            if (length > 0 && !in.read(&record.name[0], static_cast<std::streamsize>(length))) {
+                return false;
+            }
+            return record.op == TraceOp::CREATE || read_varint(in, record.mode);
+        }
+        case TraceOp::READ:
+            return read_varint(in, record.size) && read_varint(in, record.offset);
+        case TraceOp::WRITE:
+            return read_varint(in, record.size) && read_varint(in, record.offset) &&
+                   read_varint(in, record.delta_size) && read_fixed(in, record.content_hash);
+        case TraceOp::ROLLBACK:
+            return read_varint(in, record.version);
+        case TraceOp::CLOSE:
+        case TraceOp::GARBAGE_COLLECT:
+            return true;
+    }
+    return false;
+}
+
+} // namespace cowfs
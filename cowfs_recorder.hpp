@@ -0,0 +1,98 @@
+#ifndef COWFS_RECORDER_HPP
+#define COWFS_RECORDER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Grabacion de la secuencia de llamadas publicas de COWFileSystem en una
+// traza binaria compacta, para reproducirla despues (tools/cowfs_replay.cpp).
+//
+// Formato: cabecera "COWFSWLT", version de formato y tamano de la imagen
+// (enteros de 64 bits en orden nativo), seguida de un registro por llamada:
+// el codigo de operacion (1 byte) y sus campos codificados como varints
+// (LEB128; los campos con signo en zigzag). El hash del contenido de una
+// escritura ocupa 8 bytes fijos.
+
+namespace cowfs {
+
+enum class TraceOp : uint8_t {
+    CREATE = 1,
+    OPEN,
+    READ,
+    WRITE,
+    CLOSE,
+    ROLLBACK,
+    GARBAGE_COLLECT,
+};
+
+const char* trace_op_name(TraceOp op);
+
+struct TraceRecord {
+    explicit TraceRecord(TraceOp op = TraceOp::CREATE) : op(op) {}
+
+    TraceOp op;
+    uint64_t timestamp_ns = 0;   // Desde el inicio de la grabacion
+    int64_t fd = -1;
+    int64_t result = 0;          // Valor devuelto por la llamada
+    std::string name;            // create y open
+    uint64_t mode = 0;           // open: FileMode
+    uint64_t version = 0;        // rollback_to_version
+    uint64_t size = 0;           // read y write: bytes pedidos
+    uint64_t offset = 0;         // read: posicion; write: delta_start
+    uint64_t delta_size = 0;     // write: tamano del delta (0 si no hubo cambios)
+    uint64_t content_hash = 0;   // write: FNV-1a del buffer
+};
+
+// FNV-1a de 64 bits; identifica el contenido escrito y sirve de semilla
+// para sintetizarlo en la reproduccion
+uint64_t content_hash(const void* data, size_t size);
+
+/**
+ * @brief Escribe registros de traza en un archivo
+ *
+ * Igual que COWFileSystem, no es thread-safe: las llamadas deben llegar
+ * serializadas.
+ */
+class WorkloadRecorder {
+public:
+    WorkloadRecorder(const std::string& path, uint64_t disk_size);
+    ~WorkloadRecorder();
+    WorkloadRecorder(const WorkloadRecorder&) = delete;
+    WorkloadRecorder& operator=(const WorkloadRecorder&) = delete;
+
+    bool is_open() const { return out.is_open() && out.good(); }
+
+    // Completa timestamp_ns y anade el registro a la traza
+    void record(TraceRecord& record);
+    uint64_t records_written() const { return records; }
+
+private:
+    std::ofstream out;
+    std::chrono::steady_clock::time_point start;
+    uint64_t last_timestamp_ns = 0;
+    uint64_t records = 0;
+};
+
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path);
+
+    // false si el archivo no existe o la cabecera no es valida
+    bool is_open() const { return valid; }
+    uint64_t disk_size() const { return image_size; }
+
+    // Lee el siguiente registro; false al final de la traza o si esta truncada
+    bool next(TraceRecord& record);
+
+private:
+    std::ifstream in;
+    bool valid = false;
+    uint64_t image_size = 0;
+    uint64_t last_timestamp_ns = 0;
+};
+
+} // namespace cowfs
+
+#endif // COWFS_RECORDER_HPP
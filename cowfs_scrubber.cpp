@@ -0,0 +1,194 @@
+#include "cowfs_scrubber.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace cowfs {
+
+Scrubber::Scrubber(COWFileSystem& fs, std::mutex& fs_mutex, ScrubberOptions options)
+    : fs(fs), fs_mutex(fs_mutex), options(std::move(options)) {
+    if (this->options.batch_blocks == 0) {
+        this->options.batch_blocks = 1;
+    }
+}
+
+Scrubber::~Scrubber() {
+    stop();
+}
+
+void Scrubber::start() {
+    if (worker.joinable()) {
+        return;
+    }
+    load_cursor();
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stopping = false;
+    }
+    worker = std::thread(&Scrubber::run, this);
+}
+
+void Scrubber::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_signal.notify_all();
+    worker.join();
+    save_cursor();
+}
+
+size_t Scrubber::scrub_batch() {
+    size_t cursor;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        cursor = state.cursor;
+    }
+
+    std::vector<BadBlock> found;
+    size_t verified = 0;
+    size_t next;
+    {
+        std::lock_guard<std::mutex> lock(fs_mutex);
+        next = fs.scrub_blocks(cursor, options.batch_blocks, found, verified);
+    }
+
+    // Cada bloque danado se informa una sola vez aunque siga danado en
+    // pasadas posteriores. Los del lote que ahora estan sanos o ya no se
+    // usan se olvidan, y se vuelven a informar si fallan de nuevo
+    std::vector<BadBlock> fresh;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto first = bad.lower_bound(cursor);
+        auto last = next == 0 ? bad.end() : bad.lower_bound(next);
+        for (auto it = first; it != last;) {
+            bool still_bad = std::any_of(found.begin(), found.end(),
+                                         [&it](const BadBlock& block) { return block.block_index == it->first; });
+            it = still_bad ? std::next(it) : bad.erase(it);
+        }
+        state.blocks_verified += verified;
+        if (next == 0) {
+            state.passes++;
+            state.cursor = 1;
+        } else {
+            state.cursor = next;
+        }
+        for (auto& block : found) {
+            auto known = bad.find(block.block_index);
+            if (known != bad.end()) {
+                // Las versiones que lo usan pueden haber cambiado
+                known->second = std::move(block);
+                continue;
+            }
+            COWFS_LOG_ERROR("scrub: Checksum mismatch in block " << block.block_index << " ("
+                            << block.references.size() << " versions reference it)");
+            bad.emplace(block.block_index, block);
+            fresh.push_back(std::move(block));
+        }
+        state.bad_blocks = bad.size();
+    }
+    if (options.on_bad_block) {
+        for (const auto& block : fresh) {
+            options.on_bad_block(block);
+        }
+    }
+    return verified * BLOCK_SIZE;
+}
+
+void Scrubber::run() {
+    using clock = std::chrono::steady_clock;
+    const double bytes_per_second = std::max(options.megabytes_per_second, 0.001) * 1e6;
+
+    clock::time_point next_batch = clock::now();
+    clock::time_point last_checkpoint = next_batch;
+    uint64_t passes = status().passes;
+    size_t pass_bytes = 0;
+
+    while (true) {
+        size_t bytes = scrub_batch();
+        pass_bytes += bytes;
+
+        // Cubo de tokens sin credito acumulado: si un lote se retrasa (por
+        // ejemplo esperando el mutex) no se recupera el tiempo con rafagas
+        clock::time_point now = clock::now();
+        next_batch = std::max(next_batch, now - std::chrono::milliseconds(10)) +
+                     std::chrono::duration_cast<clock::duration>(
+                         std::chrono::duration<double>(static_cast<double>(bytes) / bytes_per_second));
+
+        uint64_t current_passes = status().passes;
+        if (current_passes != passes) {
+            COWFS_LOG_INFO("scrub: Pass " << current_passes << " completed, " << pass_bytes << " bytes verified");
+            // Un disco sin bloques en uso no debe convertirse en un bucle activo
+            if (pass_bytes == 0) {
+                next_batch = now + options.checkpoint_interval;
+            }
+            passes = current_passes;
+            pass_bytes = 0;
+        }
+        if (now - last_checkpoint >= options.checkpoint_interval) {
+            save_cursor();
+            last_checkpoint = now;
+        }
+
+        std::unique_lock<std::mutex> lock(stop_mutex);
+        if (stop_signal.wait_until(lock, next_batch, [this]() { return stopping; })) {
+            return;
+        }
+    }
+}
+
+void Scrubber::load_cursor() {
+    if (options.cursor_path.empty()) {
+        return;
+    }
+    std::ifstream in(options.cursor_path);
+    size_t cursor = 0;
+    uint64_t passes = 0;
+    if (in >> cursor >> passes) {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        state.cursor = std::max<size_t>(cursor, 1);
+        state.passes = passes;
+        COWFS_LOG_INFO("scrub: Resuming at block " << state.cursor);
+    }
+}
+
+void Scrubber::save_cursor() const {
+    if (options.cursor_path.empty()) {
+        return;
+    }
+    ScrubberStatus current = status();
+    // Escritura en un temporal y rename, para no dejar un cursor a medias
+    std::string temp_path = options.cursor_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (!(out << current.cursor << " " << current.passes << "\n")) {
+            COWFS_LOG_WARN("scrub: Could not write cursor file " << temp_path);
+            return;
+        }
+    }
+    if (std::rename(temp_path.c_str(), options.cursor_path.c_str()) != 0) {
+        COWFS_LOG_WARN("scrub: Could not replace cursor file " << options.cursor_path);
+    }
+}
+
+ScrubberStatus Scrubber::status() const {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    return state;
+}
+
+std::vector<BadBlock> Scrubber::bad_blocks() const {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    std::vector<BadBlock> result;
+    result.reserve(bad.size());
+    for (const auto& entry : bad) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+} // namespace cowfs
@@ -0,0 +1,90 @@
+#ifndef COWFS_SCRUBBER_HPP
+#define COWFS_SCRUBBER_HPP
+
+#include "cowfs.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Verificacion en segundo plano de los CRC32C de todos los bloques en uso,
+// para detectar corrupcion en versiones que nadie lee.
+//
+// COWFileSystem no es thread-safe: el scrubber toma el mismo mutex que usa
+// la aplicacion para serializar sus llamadas, un lote de bloques cada vez.
+
+namespace cowfs {
+
+struct ScrubberOptions {
+    // Ritmo maximo de verificacion, en MB (10^6 bytes) de bloques en uso por segundo
+    double megabytes_per_second = 16.0;
+    // Bloques examinados por cada toma del mutex
+    size_t batch_blocks = 64;
+    // Archivo donde se guarda el cursor para reanudar tras reiniciar; vacio
+    // para no persistirlo
+    std::string cursor_path;
+    std::chrono::milliseconds checkpoint_interval{1000};
+    // Se llama, sin el mutex tomado, la primera vez que se encuentra cada bloque
+    // danado, y otra vez si falla de nuevo tras verse sano o libre
+    std::function<void(const BadBlock&)> on_bad_block;
+};
+
+struct ScrubberStatus {
+    size_t cursor = 1;              // Siguiente bloque a examinar
+    uint64_t passes = 0;            // Pasadas completas sobre el disco
+    uint64_t blocks_verified = 0;
+    uint64_t bad_blocks = 0;        // Bloques danados ahora (no acumulado), como bad_blocks()
+};
+
+class Scrubber {
+public:
+    /**
+     * @param fs_mutex Mutex que protege todas las llamadas a fs
+     */
+    Scrubber(COWFileSystem& fs, std::mutex& fs_mutex, ScrubberOptions options = ScrubberOptions());
+    ~Scrubber();
+    Scrubber(const Scrubber&) = delete;
+    Scrubber& operator=(const Scrubber&) = delete;
+
+    // Lanza el hilo; continua desde el cursor guardado en cursor_path si existe
+    void start();
+    // Detiene el hilo y guarda el cursor
+    void stop();
+
+    /**
+     * @brief Verifica un lote en el hilo actual, sin limite de ritmo
+     * @return Bytes de bloques en uso verificados
+     */
+    size_t scrub_batch();
+
+    ScrubberStatus status() const;
+    // Bloques danados en su ultima verificacion, por indice
+    std::vector<BadBlock> bad_blocks() const;
+
+private:
+    void run();
+    void load_cursor();
+    void save_cursor() const;
+
+    COWFileSystem& fs;
+    std::mutex& fs_mutex;
+    ScrubberOptions options;
+
+    mutable std::mutex state_mutex;
+    ScrubberStatus state;
+    // Bloques danados en la ultima verificacion de cada uno, por indice
+    std::map<size_t, BadBlock> bad;
+
+    std::mutex stop_mutex;
+    std::condition_variable stop_signal;
+    bool stopping = false;
+    std::thread worker;
+};
+
+} // namespace cowfs
+
+#endif // COWFS_SCRUBBER_HPP
@@ -0,0 +1,365 @@
+#include "cowfs.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace cowfs {
+
+namespace {
+
+// Formato del flujo (enteros de 64 bits en orden nativo):
+//   cabecera: magic y version de formato
+//   por archivo: marca 1, nombre, reemplazo (1 byte), version y digest base,
+//                numero de versiones, las versiones y el digest final
+//   version:     numero, tamano, delta_start, delta_size, timestamp y los
+//                bytes almacenados [delta_start, tamano)
+//   fin:         marca 0 y numero de archivos enviados
+const char STREAM_MAGIC[8] = {'C', 'O', 'W', 'F', 'S', 'S', 'N', 'D'};
+constexpr uint64_t STREAM_FORMAT_VERSION = 1;
+
+void write_u64(std::ostream& out, uint64_t value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void write_string(std::ostream& out, const std::string& value) {
+    write_u64(out, value.size());
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+template <typename T>
+bool read_u64(std::istream& in, T& value) {
+    uint64_t raw = 0;
+    if (!in.read(reinterpret_cast<char*>(&raw), sizeof(raw))) {
+        return false;
+    }
+    value = static_cast<T>(raw);
+    return true;
+}
+
+bool read_string(std::istream& in, std::string& value) {
+    uint64_t length = 0;
+    if (!read_u64(in, length) || length > 4096) {
+        return false;
+    }
+    value.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&value[0], static_cast<std::streamsize>(length)));
+}
+
+} // namespace
+
+Snapshot COWFileSystem::snapshot() {
+    Snapshot result;
+    for (auto& inode : inodes) {
+        if (!inode.is_used) {
+            continue;
+        }
+        Snapshot::Entry entry{inode.version_count, merkle_digest(nullptr, 0)};
+        if (!inode.version_history.empty()) {
+            size_t head = inode.version_history.size() - 1;
+            entry.digest = merkle_digest(version_merkle(inode, head), inode.version_history[head].size);
+        }
+        result.files[inode.filename] = entry;
+    }
+    return result;
+}
+
+bool COWFileSystem::send(const Snapshot& from, const Snapshot& to, std::ostream& out) {
+    out.write(STREAM_MAGIC, sizeof(STREAM_MAGIC));
+    write_u64(out, STREAM_FORMAT_VERSION);
+
+    // Digest de la version con ese numero; false si ya no existe
+    auto version_digest = [this](Inode& inode, size_t version_number, uint64_t& digest) {
+        if (version_number == 0) {
+            digest = merkle_digest(nullptr, 0);
+            return true;
+        }
+        if (version_number > inode.version_history.size() ||
+            inode.version_history[version_number - 1].version_number != version_number) {
+            return false;
+        }
+        const VersionInfo& version = inode.version_history[version_number - 1];
+        digest = merkle_digest(version_merkle(inode, version_number - 1), version.size);
+        return true;
+    };
+
+    uint64_t files_sent = 0;
+    std::vector<uint8_t> stored;
+    for (const auto& target : to.files) {
+        Inode* inode = find_inode(target.first);
+        uint64_t digest = 0;
+        if (!inode || !version_digest(*inode, target.second.version, digest) || digest != target.second.digest) {
+            COWFS_LOG_ERROR("send: Target snapshot no longer matches file '" << target.first << "'");
+            return false;
+        }
+
+        size_t base_version = 0;
+        uint64_t base_digest = merkle_digest(nullptr, 0);
+        bool replace = false;
+        auto base = from.files.find(target.first);
+        if (base != from.files.end()) {
+            if (base->second.version <= target.second.version &&
+                version_digest(*inode, base->second.version, digest) && digest == base->second.digest) {
+                base_version = base->second.version;
+                base_digest = digest;
+            } else {
+                // La version base se descarto con un rollback: historial completo
+                replace = true;
+            }
+            if (!replace && base_version == target.second.version) {
+                continue;
+            }
+        }
+
+        out.put(1);
+        write_string(out, inode->filename);
+        out.put(replace ? 1 : 0);
+        write_u64(out, base_version);
+        write_u64(out, base_digest);
+        write_u64(out, target.second.version - base_version);
+        for (size_t i = base_version; i < target.second.version; ++i) {
+            const VersionInfo& version = inode->version_history[i];
+            size_t stored_size = version.size - std::min(version.delta_start, version.size);
+            write_u64(out, version.version_number);
+            write_u64(out, version.size);
+            write_u64(out, version.delta_start);
+            write_u64(out, version.delta_size);
+            write_string(out, version.timestamp);
+            write_u64(out, stored_size);
+            stored.resize(stored_size);
+            if (stored_size > 0 && !read_chain(version.block_index, 0, stored_size, stored.data())) {
+                COWFS_LOG_ERROR("send: Could not read version " << version.version_number
+                                << " of '" << inode->filename << "'");
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored_size));
+        }
+        write_u64(out, target.second.digest);
+        files_sent++;
+    }
+
+    out.put(0);
+    write_u64(out, files_sent);
+    out.flush();
+    COWFS_LOG_INFO("send: " << files_sent << " files sent");
+    return static_cast<bool>(out);
+}
+
+bool COWFileSystem::receive(std::istream& in) {
+    char magic[sizeof(STREAM_MAGIC)];
+    uint64_t format_version = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, STREAM_MAGIC, sizeof(magic)) != 0 ||
+        !read_u64(in, format_version) || format_version != STREAM_FORMAT_VERSION) {
+        COWFS_LOG_ERROR("receive: Invalid stream header");
+        return false;
+    }
+
+    uint64_t files_received = 0;
+    while (true) {
+        int marker = in.get();
+        if (marker == 0) {
+            uint64_t files_sent = 0;
+            if (!read_u64(in, files_sent) || files_sent != files_received) {
+                COWFS_LOG_ERROR("receive: Truncated stream");
+                return false;
+            }
+            COWFS_LOG_INFO("receive: " << files_received << " files received");
+            return true;
+        }
+        if (marker != 1) {
+            COWFS_LOG_ERROR("receive: Truncated stream");
+            return false;
+        }
+
+        std::string name;
+        int replace = 0;
+        size_t base_version = 0, version_count = 0;
+        uint64_t base_digest = 0;
+        if (!read_string(in, name) || name.size() >= MAX_FILENAME_LENGTH ||
+            (replace = in.get()) == std::istream::traits_type::eof() ||
+            !read_u64(in, base_version) || !read_u64(in, base_digest) || !read_u64(in, version_count)) {
+            COWFS_LOG_ERROR("receive: Truncated stream");
+            return false;
+        }
+
+        // Todas las versiones del archivo se leen antes de tocarlo: un flujo
+        // cortado no deja el archivo a medias
+        std::vector<ReceivedVersion> received;
+        for (size_t v = 0; v < version_count; ++v) {
+            ReceivedVersion version;
+            size_t stored_size = 0;
+            if (!read_u64(in, version.info.version_number) || !read_u64(in, version.info.size) ||
+                !read_u64(in, version.info.delta_start) || !read_u64(in, version.info.delta_size) ||
+                !read_string(in, version.info.timestamp) || !read_u64(in, stored_size) ||
+                stored_size > blocks.size() * BLOCK_SIZE) {
+                COWFS_LOG_ERROR("receive: Truncated stream");
+                return false;
+            }
+            version.stored.resize(stored_size);
+            if (stored_size > 0 && !in.read(reinterpret_cast<char*>(version.stored.data()),
+                                             static_cast<std::streamsize>(stored_size))) {
+                COWFS_LOG_ERROR("receive: Truncated stream");
+                return false;
+            }
+            received.push_back(std::move(version));
+        }
+        uint64_t target_digest = 0;
+        if (!read_u64(in, target_digest)) {
+            COWFS_LOG_ERROR("receive: Truncated stream");
+            return false;
+        }
+
+        if (!apply_received_file(name, replace != 0, base_version, base_digest, received, target_digest)) {
+            return false;
+        }
+        files_received++;
+    }
+}
+
+bool COWFileSystem::apply_received_file(const std::string& name, bool replace, size_t base_version,
+                                        uint64_t base_digest, const std::vector<ReceivedVersion>& received,
+                                        uint64_t target_digest) {
+    Inode* inode = find_inode(name);
+    size_t target_version = received.empty() ? base_version : received.back().info.version_number;
+    if (inode && inode->version_count == target_version && !inode->version_history.empty()) {
+        // Ya aplicado por un intento anterior del mismo flujo
+        size_t head = inode->version_history.size() - 1;
+        if (merkle_digest(version_merkle(*inode, head), inode->version_history[head].size) == target_digest) {
+            return true;
+        }
+    }
+
+    std::vector<uint8_t> content;
+    if (!replace) {
+        // El receptor debe estar exactamente en la version base del emisor
+        uint64_t digest = merkle_digest(nullptr, 0);
+        size_t current_version = inode ? inode->version_count : 0;
+        if (inode && current_version > 0) {
+            size_t head = inode->version_history.size() - 1;
+            digest = merkle_digest(version_merkle(*inode, head), inode->version_history[head].size);
+            content.resize(inode->version_history[head].size);
+            if (!content.empty() && !read_version_range(*inode, head, 0, content.size(), content.data())) {
+                COWFS_LOG_ERROR("receive: Could not read the current version of '" << name << "'");
+                return false;
+            }
+        }
+        if (current_version != base_version || digest != base_digest) {
+            COWFS_LOG_ERROR("receive: '" << name << "' is at version " << current_version
+                            << ", not at the base version " << base_version << " of the stream");
+            return false;
+        }
+    }
+
+    // Se reconstruye el contenido final para comprobar el digest del emisor
+    // antes de asignar bloques
+    size_t next_version = replace ? 1 : base_version + 1;
+    for (const auto& version : received) {
+        const VersionInfo& info = version.info;
+        if (info.version_number != next_version++ || info.delta_start > info.size ||
+            info.delta_start > content.size() || version.stored.size() != info.size - info.delta_start) {
+            COWFS_LOG_ERROR("receive: Inconsistent version " << info.version_number << " for '" << name << "'");
+            return false;
+        }
+        content.resize(info.size);
+        if (!version.stored.empty()) {
+            std::memcpy(content.data() + info.delta_start, version.stored.data(), version.stored.size());
+        }
+    }
+    uint64_t digest = content.empty() ? merkle_digest(nullptr, 0)
+                                      : merkle_digest(merkle_build(content.data(), content.size()), content.size());
+    if (digest != target_digest) {
+        COWFS_LOG_ERROR("receive: Content of '" << name << "' does not match the sender");
+        return false;
+    }
+
+    bool created = false;
+    if (!inode) {
+        fd_t fd = create_impl(name);
+        if (fd < 0) {
+            return false;
+        }
+        free_file_descriptor(fd);
+        inode = find_inode(name);
+        created = true;
+    }
+
+    // Con reemplazo el historial anterior se aparta sin soltar sus bloques,
+    // para poder restaurarlo si falta espacio
+    std::vector<VersionInfo> replaced;
+    if (replace) {
+        version_record_bytes -= history_bytes(inode->version_history);
+        replaced.swap(inode->version_history);
+        version_record_bytes += history_bytes(inode->version_history);
+        inode->first_block = 0;
+        inode->size = 0;
+        inode->version_count = 0;
+    }
+    size_t kept_versions = inode->version_history.size();
+    for (const auto& version : received) {
+        if (!append_received_version(*inode, version.info, version.stored.data(), version.stored.size())) {
+            truncate_history(*inode, kept_versions);
+            if (replace) {
+                version_record_bytes -= history_bytes(inode->version_history);
+                inode->version_history.swap(replaced);
+                version_record_bytes += history_bytes(inode->version_history);
+                truncate_history(*inode, inode->version_history.size());
+            }
+            if (created) {
+                inode->is_used = false;
+            }
+            return false;
+        }
+    }
+    for (const auto& version : replaced) {
+        decrement_block_refs(version.block_index);
+    }
+    return true;
+}
+
+bool COWFileSystem::append_received_version(Inode& inode, VersionInfo version,
+                                            const uint8_t* stored, size_t stored_size) {
+    // El prefijo [0, delta_start) se lee de la version anterior, que debe cubrirlo
+    size_t previous_size = inode.version_history.empty() ? 0 : inode.version_history.back().size;
+    if (version.version_number != inode.version_count + 1 || version.delta_start > version.size ||
+        version.delta_start > previous_size || stored_size != version.size - version.delta_start) {
+        COWFS_LOG_ERROR("receive: Inconsistent version " << version.version_number
+                        << " for '" << inode.filename << "'");
+        return false;
+    }
+
+    size_t first_block = 0;
+    if (stored_size > 0 && !write_chain(stored, stored_size, first_block)) {
+        COWFS_LOG_ERROR("receive: Could not allocate blocks for version " << version.version_number);
+        return false;
+    }
+    increment_block_refs(first_block);
+    version.block_index = first_block;
+    version.prev_version = inode.version_count;
+    version.merkle = nullptr;
+    delta_bytes_written += version.delta_size;
+
+    version_record_bytes -= history_bytes(inode.version_history);
+    inode.version_history.push_back(std::move(version));
+    version_record_bytes += history_bytes(inode.version_history);
+    inode.first_block = first_block;
+    inode.size = inode.version_history.back().size;
+    inode.version_count++;
+    refresh_head_pins(inode);
+    return true;
+}
+
+void COWFileSystem::truncate_history(Inode& inode, size_t keep) {
+    for (size_t i = keep; i < inode.version_history.size(); ++i) {
+        decrement_block_refs(inode.version_history[i].block_index);
+    }
+    version_record_bytes -= history_bytes(inode.version_history);
+    inode.version_history.resize(std::min(keep, inode.version_history.size()));
+    version_record_bytes += history_bytes(inode.version_history);
+    inode.version_count = inode.version_history.size();
+    inode.first_block = inode.version_history.empty() ? 0 : inode.version_history.back().block_index;
+    inode.size = inode.version_history.empty() ? 0 : inode.version_history.back().size;
+    refresh_head_pins(inode);
+}
+
+} // namespace cowfs
@@ -0,0 +1,347 @@
+#include "cowfs_stats.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace cowfs {
+
+namespace {
+
+std::atomic<uint64_t> next_collector_id{1};
+
+// Incremento sin RMW: cada contador tiene un unico hilo escritor
+inline void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline uint64_t monotonic_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Factor de decaimiento del calor tras elapsed_ns
+inline double heat_decay(uint64_t elapsed_ns) {
+    return std::exp2(-static_cast<double>(elapsed_ns) / (HEAT_HALF_LIFE_SECONDS * 1e9));
+}
+
+inline unsigned highest_bit(uint64_t value) {
+    return 63u - static_cast<unsigned>(__builtin_clzll(value));
+}
+
+} // namespace
+
+const char* operation_name(Operation op) {
+    switch (op) {
+        case Operation::CREATE: return "create";
+        case Operation::OPEN: return "open";
+        case Operation::READ: return "read";
+        case Operation::WRITE: return "write";
+        case Operation::ROLLBACK: return "rollback_to_version";
+        case Operation::GARBAGE_COLLECT: return "garbage_collect";
+        case Operation::ALLOCATE_BLOCK: return "allocate_block";
+        default: return "unknown";
+    }
+}
+
+size_t LatencyHistogram::bucket_for(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    unsigned magnitude = highest_bit(value);
+    size_t sub_bucket = static_cast<size_t>(value >> (magnitude - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned magnitude = static_cast<unsigned>(bucket / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint64_t sub_bucket = bucket % SUB_BUCKETS;
+    unsigned shift = magnitude - SUB_BUCKET_BITS;
+    uint64_t next_lower = (SUB_BUCKETS + sub_bucket + 1) << shift;
+    // El ultimo bucket termina en el maximo de 64 bits
+    return next_lower == 0 ? UINT64_MAX : next_lower - 1;
+}
+
+uint64_t LatencySnapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    quantile = std::min(1.0, std::max(0.0, quantile));
+    uint64_t target = static_cast<uint64_t>(quantile * static_cast<double>(count));
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= target) {
+            return std::min(LatencyHistogram::bucket_upper_bound(i), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+double LatencySnapshot::mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum_ns) / static_cast<double>(count);
+}
+
+struct alignas(64) StatsCollector::Shard {
+    struct OperationCounters {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> sum_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::atomic<uint64_t> buckets[LatencyHistogram::BUCKET_COUNT] = {};
+    };
+
+    // Calor por shard: como el decaimiento es lineal, la suma de los calores
+    // de cada shard decaidos hasta el mismo instante es el calor total
+    struct FileCounters {
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> read_bytes{0};
+        std::atomic<uint64_t> writes{0};
+        std::atomic<uint64_t> write_bytes{0};
+        std::atomic<uint64_t> last_access_ns{0};
+        std::atomic<double> heat{0.0};
+    };
+
+    Shard(size_t file_slots, std::thread::id owner) : files(new FileCounters[file_slots]), owner(owner) {}
+
+    OperationCounters operations[OPERATION_COUNT];
+    std::unique_ptr<FileCounters[]> files;
+    // Un hilo nuevo puede heredar el id de uno terminado y con el su shard
+    std::thread::id owner;
+};
+
+StatsCollector::StatsCollector(size_t file_slots)
+    : collector_id(next_collector_id.fetch_add(1, std::memory_order_relaxed)), file_slots(file_slots) {}
+
+StatsCollector::~StatsCollector() = default;
+
+StatsCollector::Shard& StatsCollector::local_shard() {
+    // Cache por hilo de tamano fijo, indexada por coleccionista. Los ids
+    // nunca se reutilizan, asi que la entrada de un coleccionista destruido
+    // nunca vuelve a coincidir y se sobrescribe con la siguiente que caiga
+    // en su posicion
+    thread_local std::array<std::pair<uint64_t, Shard*>, LOCAL_SHARD_CACHE_SLOTS> cache{};
+    auto& entry = cache[collector_id % LOCAL_SHARD_CACHE_SLOTS];
+    if (entry.first == collector_id) {
+        return *entry.second;
+    }
+
+    // Fallo de la cache: el shard del hilo se busca con el lock tomado
+    const std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    Shard* shard = nullptr;
+    for (const auto& candidate : shards) {
+        if (candidate->owner == self) {
+            shard = candidate.get();
+            break;
+        }
+    }
+    if (!shard) {
+        shards.push_back(std::make_unique<Shard>(file_slots, self));
+        shard = shards.back().get();
+    }
+    entry = {collector_id, shard};
+    return *shard;
+}
+
+void StatsCollector::record(Operation op, uint64_t latency_ns, uint64_t bytes, bool ok) {
+    auto& counters = local_shard().operations[static_cast<size_t>(op)];
+    bump(counters.count, 1);
+    if (!ok) {
+        bump(counters.errors, 1);
+    }
+    bump(counters.bytes, bytes);
+    bump(counters.sum_ns, latency_ns);
+    if (latency_ns > counters.max_ns.load(std::memory_order_relaxed)) {
+        counters.max_ns.store(latency_ns, std::memory_order_relaxed);
+    }
+    bump(counters.buckets[LatencyHistogram::bucket_for(latency_ns)], 1);
+}
+
+FsStats StatsCollector::snapshot() const {
+    FsStats result;
+    for (auto& op_stats : result.operations) {
+        op_stats.latency.buckets.assign(LatencyHistogram::BUCKET_COUNT, 0);
+    }
+
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for (const auto& shard : shards) {
+        for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+            const auto& counters = shard->operations[op];
+            auto& op_stats = result.operations[op];
+            op_stats.count += counters.count.load(std::memory_order_relaxed);
+            op_stats.errors += counters.errors.load(std::memory_order_relaxed);
+            op_stats.bytes += counters.bytes.load(std::memory_order_relaxed);
+            op_stats.latency.sum_ns += counters.sum_ns.load(std::memory_order_relaxed);
+            op_stats.latency.max_ns = std::max(op_stats.latency.max_ns,
+                                               counters.max_ns.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < LatencyHistogram::BUCKET_COUNT; ++b) {
+                uint64_t value = counters.buckets[b].load(std::memory_order_relaxed);
+                op_stats.latency.buckets[b] += value;
+                op_stats.latency.count += value;
+            }
+        }
+    }
+    return result;
+}
+
+void StatsCollector::record_file_access(size_t slot, bool is_write, uint64_t bytes) {
+    if (slot >= file_slots) {
+        return;
+    }
+    auto& counters = local_shard().files[slot];
+    if (is_write) {
+        bump(counters.writes, 1);
+        bump(counters.write_bytes, bytes);
+    } else {
+        bump(counters.reads, 1);
+        bump(counters.read_bytes, bytes);
+    }
+    uint64_t now = monotonic_ns();
+    uint64_t last = counters.last_access_ns.load(std::memory_order_relaxed);
+    double heat = counters.heat.load(std::memory_order_relaxed);
+    counters.heat.store(heat * heat_decay(now - last) + 1.0, std::memory_order_relaxed);
+    counters.last_access_ns.store(now, std::memory_order_relaxed);
+}
+
+size_t StatsCollector::memory_usage() const {
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    return shards.capacity() * sizeof(std::unique_ptr<Shard>) +
+           shards.size() * (sizeof(Shard) + file_slots * sizeof(Shard::FileCounters));
+}
+
+std::vector<FileAccessStats> StatsCollector::file_snapshot() const {
+    std::vector<FileAccessStats> result(file_slots);
+    std::vector<uint64_t> last_access(file_slots, 0);
+    uint64_t now = monotonic_ns();
+
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for (const auto& shard : shards) {
+        for (size_t slot = 0; slot < file_slots; ++slot) {
+            const auto& counters = shard->files[slot];
+            uint64_t last = counters.last_access_ns.load(std::memory_order_relaxed);
+            if (last == 0) {
+                continue;
+            }
+            auto& file = result[slot];
+            file.reads += counters.reads.load(std::memory_order_relaxed);
+            file.read_bytes += counters.read_bytes.load(std::memory_order_relaxed);
+            file.writes += counters.writes.load(std::memory_order_relaxed);
+            file.write_bytes += counters.write_bytes.load(std::memory_order_relaxed);
+            file.heat += counters.heat.load(std::memory_order_relaxed) * heat_decay(now > last ? now - last : 0);
+            last_access[slot] = std::max(last_access[slot], last);
+        }
+    }
+
+    // Se traduce el reloj monotono a tiempo de pared en el momento de la instantanea
+    uint64_t wall_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    for (size_t slot = 0; slot < file_slots; ++slot) {
+        if (last_access[slot] != 0) {
+            uint64_t age_ms = (now - last_access[slot]) / 1000000;
+            result[slot].last_access_ms = wall_ms > age_ms ? wall_ms - age_ms : 0;
+        }
+    }
+    return result;
+}
+
+std::string format_stats_text(const FsStats& stats) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    std::ostringstream out;
+    out << "# TYPE cowfs_operations_total counter\n";
+    for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+        out << "cowfs_operations_total{op=\"" << operation_name(static_cast<Operation>(op)) << "\"} "
+            << stats.operations[op].count << "\n";
+    }
+    out << "# TYPE cowfs_operation_errors_total counter\n";
+    for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+        out << "cowfs_operation_errors_total{op=\"" << operation_name(static_cast<Operation>(op)) << "\"} "
+            << stats.operations[op].errors << "\n";
+    }
+    out << "# TYPE cowfs_operation_bytes_total counter\n";
+    for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+        out << "cowfs_operation_bytes_total{op=\"" << operation_name(static_cast<Operation>(op)) << "\"} "
+            << stats.operations[op].bytes << "\n";
+    }
+    out << "# TYPE cowfs_operation_latency_ns summary\n";
+    for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+        const char* name = operation_name(static_cast<Operation>(op));
+        const auto& latency = stats.operations[op].latency;
+        for (double q : quantiles) {
+            out << "cowfs_operation_latency_ns{op=\"" << name << "\",quantile=\"" << q << "\"} "
+                << latency.percentile(q) << "\n";
+        }
+        out << "cowfs_operation_latency_ns_sum{op=\"" << name << "\"} " << latency.sum_ns << "\n";
+        out << "cowfs_operation_latency_ns_count{op=\"" << name << "\"} " << latency.count << "\n";
+        out << "cowfs_operation_latency_ns_max{op=\"" << name << "\"} " << latency.max_ns << "\n";
+    }
+    return out.str();
+}
+
+size_t AllocatorMetrics::bucket_for(uint64_t extent_blocks) {
+    if (extent_blocks == 0) {
+        return 0;
+    }
+    return std::min<size_t>(highest_bit(extent_blocks), HISTOGRAM_BUCKETS - 1);
+}
+
+double AllocatorMetrics::write_amplification() const {
+    if (delta_bytes == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(allocated_bytes + copied_bytes) / static_cast<double>(delta_bytes);
+}
+
+std::string format_allocator_metrics_text(const AllocatorMetrics& metrics) {
+    std::ostringstream out;
+    out << "# TYPE cowfs_blocks_total gauge\n"
+        << "cowfs_blocks_total " << metrics.total_blocks << "\n"
+        << "# TYPE cowfs_free_blocks gauge\n"
+        << "cowfs_free_blocks " << metrics.free_blocks << "\n"
+        << "# TYPE cowfs_free_extents gauge\n"
+        << "cowfs_free_extents " << metrics.free_extents << "\n"
+        << "# TYPE cowfs_largest_free_extent_blocks gauge\n"
+        << "cowfs_largest_free_extent_blocks " << metrics.largest_free_extent << "\n";
+
+    // Histograma acumulado hasta el ultimo bucket no vacio
+    size_t last = 0;
+    for (size_t i = 0; i < AllocatorMetrics::HISTOGRAM_BUCKETS; ++i) {
+        if (metrics.free_extent_histogram[i] > 0) {
+            last = i;
+        }
+    }
+    out << "# TYPE cowfs_free_extent_blocks histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= last; ++i) {
+        cumulative += metrics.free_extent_histogram[i];
+        out << "cowfs_free_extent_blocks_bucket{le=\"" << ((uint64_t(1) << (i + 1)) - 1) << "\"} "
+            << cumulative << "\n";
+    }
+    out << "cowfs_free_extent_blocks_bucket{le=\"+Inf\"} " << metrics.free_extents << "\n"
+        << "cowfs_free_extent_blocks_sum " << metrics.free_blocks << "\n"
+        << "cowfs_free_extent_blocks_count " << metrics.free_extents << "\n";
+
+    out << "# TYPE cowfs_chain_contiguity gauge\n"
+        << "cowfs_chain_contiguity " << metrics.mean_chain_contiguity << "\n"
+        << "# TYPE cowfs_delta_bytes_total counter\n"
+        << "cowfs_delta_bytes_total " << metrics.delta_bytes << "\n"
+        << "# TYPE cowfs_allocated_bytes_total counter\n"
+        << "cowfs_allocated_bytes_total " << metrics.allocated_bytes << "\n"
+        << "# TYPE cowfs_copied_bytes_total counter\n"
+        << "cowfs_copied_bytes_total " << metrics.copied_bytes << "\n"
+        << "# TYPE cowfs_write_amplification gauge\n"
+        << "cowfs_write_amplification " << metrics.write_amplification() << "\n";
+    return out.str();
+}
+
+} // namespace cowfs
@@ -0,0 +1,199 @@
+#ifndef COWFS_STATS_HPP
+#define COWFS_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cowfs {
+
+// Operaciones instrumentadas
+enum class Operation {
+    CREATE = 0,
+    OPEN,
+    READ,
+    WRITE,
+    ROLLBACK,
+    GARBAGE_COLLECT,
+    ALLOCATE_BLOCK,
+    COUNT
+};
+
+constexpr size_t OPERATION_COUNT = static_cast<size_t>(Operation::COUNT);
+
+const char* operation_name(Operation op);
+
+// Histograma log-lineal al estilo HDR: valores exactos por debajo de 16 y
+// 16 sub-buckets por cada potencia de dos a partir de ahi (error < 6.25%)
+struct LatencyHistogram {
+    static constexpr unsigned SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucket_for(uint64_t value);
+    static uint64_t bucket_upper_bound(size_t bucket);
+};
+
+struct LatencySnapshot {
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+
+    /**
+     * @brief Valor del percentil indicado
+     * @param quantile Cuantil entre 0 y 1 (0.99 para p99)
+     * @return Limite superior del bucket que contiene el percentil, en ns
+     */
+    uint64_t percentile(double quantile) const;
+    double mean() const;
+};
+
+struct OperationStats {
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    LatencySnapshot latency;
+};
+
+struct FsStats {
+    std::array<OperationStats, OPERATION_COUNT> operations;
+
+    const OperationStats& operator[](Operation op) const {
+        return operations[static_cast<size_t>(op)];
+    }
+};
+
+/**
+ * @brief Formatea una instantanea en formato de exposicion de texto
+ *        (compatible con Prometheus)
+ */
+std::string format_stats_text(const FsStats& stats);
+
+// Estado del asignador de bloques y coste fisico de las escrituras
+struct AllocatorMetrics {
+    // Bucket i: extensiones libres de [2^i, 2^(i+1)) bloques
+    static constexpr size_t HISTOGRAM_BUCKETS = 32;
+
+    uint64_t total_blocks = 0;
+    uint64_t free_blocks = 0;
+    uint64_t free_extents = 0;
+    uint64_t largest_free_extent = 0;          // En bloques
+    std::array<uint64_t, HISTOGRAM_BUCKETS> free_extent_histogram{};
+
+    // Fraccion de enlaces de cadena que apuntan al bloque siguiente
+    // (1.0 = todas las cadenas contiguas), media sobre los archivos
+    double mean_chain_contiguity = 1.0;
+    uint64_t chains = 0;
+
+    // Acumulados desde el montaje
+    uint64_t delta_bytes = 0;       // Bytes que cambiaron segun find_delta
+    uint64_t allocated_bytes = 0;   // Bloques asignados para versiones
+    uint64_t copied_bytes = 0;      // Bytes copiados a esos bloques
+
+    static size_t bucket_for(uint64_t extent_blocks);
+
+    /**
+     * @brief (allocated_bytes + copied_bytes) / delta_bytes
+     * @return 0 si todavia no se escribio ningun delta
+     */
+    double write_amplification() const;
+};
+
+/**
+ * @brief Formatea las metricas del asignador en formato de exposicion de
+ *        texto (compatible con Prometheus)
+ */
+std::string format_allocator_metrics_text(const AllocatorMetrics& metrics);
+
+// Vida media del indice de calor de los archivos
+constexpr double HEAT_HALF_LIFE_SECONDS = 300.0;
+
+// Accesos acumulados a un archivo
+struct FileAccessStats {
+    std::string name;
+    uint64_t reads = 0;
+    uint64_t read_bytes = 0;
+    uint64_t writes = 0;
+    uint64_t write_bytes = 0;
+    // Milisegundos desde epoch del ultimo read o write; 0 si nunca se accedio
+    uint64_t last_access_ms = 0;
+    // Accesos con decaimiento exponencial (vida media HEAT_HALF_LIFE_SECONDS)
+    double heat = 0.0;
+};
+
+// Contadores por hilo: cada hilo escribe solo en su propio shard, sin
+// operaciones atomicas de lectura-modificacion-escritura ni locks. El
+// mutex solo se toma al registrar un hilo nuevo, al tomar instantaneas y
+// cuando el hilo usa mas coleccionistas de los que caben en su cache.
+class StatsCollector {
+public:
+    /**
+     * @param file_slots Numero de archivos con contadores de acceso propios
+     *        (uno por inodo)
+     */
+    explicit StatsCollector(size_t file_slots = 0);
+    ~StatsCollector();
+    StatsCollector(const StatsCollector&) = delete;
+    StatsCollector& operator=(const StatsCollector&) = delete;
+
+    void record(Operation op, uint64_t latency_ns, uint64_t bytes, bool ok);
+    FsStats snapshot() const;
+
+    void record_file_access(size_t slot, bool is_write, uint64_t bytes);
+    // Un elemento por slot, sin nombre; el calor se decae hasta el instante actual
+    std::vector<FileAccessStats> file_snapshot() const;
+
+    // Bytes reservados por los shards de todos los hilos
+    size_t memory_usage() const;
+
+private:
+    // Coleccionistas que un hilo alterna sin tomar el mutex
+    static constexpr size_t LOCAL_SHARD_CACHE_SLOTS = 8;
+
+    struct Shard;
+    Shard& local_shard();
+
+    uint64_t collector_id;
+    size_t file_slots;
+    mutable std::mutex shards_mutex;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+// Mide la duracion de una operacion y la registra al salir del ambito
+class OperationTimer {
+public:
+    OperationTimer(StatsCollector& collector, Operation op)
+        : collector(collector), op(op), start(std::chrono::steady_clock::now()) {}
+
+    ~OperationTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        collector.record(op,
+                         static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                         bytes, ok);
+    }
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    void finish(bool success, uint64_t byte_count = 0) {
+        ok = success;
+        bytes = byte_count;
+    }
+
+private:
+    StatsCollector& collector;
+    Operation op;
+    std::chrono::steady_clock::time_point start;
+    uint64_t bytes = 0;
+    bool ok = true;
+};
+
+} // namespace cowfs
+
+#endif // COWFS_STATS_HPP
@@ -0,0 +1,365 @@
+#include "cowfs.hpp"
+#include "cowfs_log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace cowfs {
+
+namespace {
+
+constexpr uint8_t FRAME_REFERENCED = 1;  // Accedido desde la ultima pasada del reloj
+constexpr uint8_t FRAME_DIRTY = 2;       // El almacen de respaldo no tiene este contenido
+
+// block_data() protege los dos ultimos bloques accedidos; con menos marcos
+// no quedaria ninguno desalojable
+constexpr size_t MIN_FRAMES = 8;
+
+bool pread_full(int fd, uint8_t* out, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t result = ::pread(fd, out, length, offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        out += result;
+        length -= static_cast<size_t>(result);
+        offset += result;
+    }
+    return true;
+}
+
+bool pwrite_full(int fd, const uint8_t* data, size_t length, off_t offset) {
+    while (length > 0) {
+        ssize_t result = ::pwrite(fd, data, length, offset);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        data += result;
+        length -= static_cast<size_t>(result);
+        offset += result;
+    }
+    return true;
+}
+
+off_t backing_offset(size_t block_index) {
+    return static_cast<off_t>(block_index) * static_cast<off_t>(BLOCK_SIZE);
+}
+
+} // namespace
+
+void COWFileSystem::setup_payload_arena(const TieringOptions& options, const ArenaOptions& arena) {
+    tiering_enabled = options.ram_budget_bytes > 0 && options.ram_budget_bytes / BLOCK_SIZE < total_blocks;
+    if (!tiering_enabled) {
+        // Un marco fijo por bloque, que se asigna la primera vez que se usa el
+        // bloque: solo ocupan memoria los trozos con bloques escritos
+        payload_frames = total_blocks;
+        payload_arena.reserve(payload_frames, BLOCK_SIZE, arena);
+        log_arena_status();
+        return;
+    }
+
+    if (options.backing_path.empty()) {
+        throw std::runtime_error("Tiering requires a backing store path");
+    }
+    backing_fd = ::open(options.backing_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (backing_fd < 0) {
+        throw std::runtime_error("Failed to open backing store " + options.backing_path);
+    }
+    // Solo vive mientras el descriptor este abierto; la imagen guarda todo
+    ::unlink(options.backing_path.c_str());
+
+    payload_frames = std::max(options.ram_budget_bytes / BLOCK_SIZE, MIN_FRAMES);
+    payload_arena.reserve(payload_frames, BLOCK_SIZE, arena);
+    log_arena_status();
+    frame_block.assign(payload_frames, 0);
+    frame_flags.assign(payload_frames, 0);
+    free_frames.clear();
+    for (size_t frame = payload_frames; frame > 0; --frame) {
+        free_frames.push_back(frame - 1);
+    }
+    block_pins.assign(total_blocks, 0);
+    block_on_backing.assign(total_blocks, false);
+    head_pins.assign(inodes.size(), {});
+    tiering_counters = TieringStats();
+    tiering_counters.frames = payload_frames;
+    COWFS_LOG_INFO("Tiering: " << payload_frames << " frames for " << total_blocks << " blocks, backing store "
+                   << options.backing_path);
+}
+
+const uint8_t* COWFileSystem::block_data(size_t block_index) {
+    Block& block = blocks[block_index];
+    if (!tiering_enabled) {
+        if (!block.data) {
+            payload_arena.commit(block_index);
+            block.data = payload_arena.frame(block_index);
+        }
+        return block.data;
+    }
+
+    if (!block.data) {
+        tiering_counters.faults++;
+        size_t frame = acquire_frame();
+        payload_arena.commit(frame);
+        uint8_t* data = payload_arena.frame(frame);
+        if (block_on_backing[block_index]) {
+            tiering_counters.backing_reads++;
+            if (!pread_full(backing_fd, data, BLOCK_SIZE, backing_offset(block_index))) {
+                // El CRC detectara el contenido perdido al verificar el bloque
+                COWFS_LOG_ERROR("Tiering: Could not read block " << block_index << " from the backing store");
+                std::memset(data, 0, BLOCK_SIZE);
+            }
+            frame_flags[frame] = 0;
+        } else {
+            // Bloque recien asignado: aun no tiene contenido en ninguna parte
+            std::memset(data, 0, BLOCK_SIZE);
+            frame_flags[frame] = FRAME_DIRTY;
+        }
+        frame_block[frame] = block_index;
+        block.data = data;
+        tiering_counters.resident_blocks++;
+    }
+
+    size_t frame = payload_arena.index_of(block.data);
+    frame_flags[frame] |= FRAME_REFERENCED;
+    if (recent_blocks[0] != block_index) {
+        recent_blocks[1] = recent_blocks[0];
+        recent_blocks[0] = block_index;
+    }
+    return block.data;
+}
+
+uint8_t* COWFileSystem::block_data_for_write(size_t block_index) {
+    block_data(block_index);
+    if (tiering_enabled) {
+        size_t frame = payload_arena.index_of(blocks[block_index].data);
+        frame_flags[frame] |= FRAME_DIRTY;
+        block_on_backing[block_index] = false;
+    }
+    return blocks[block_index].data;
+}
+
+size_t COWFileSystem::acquire_frame() {
+    if (!free_frames.empty()) {
+        size_t frame = free_frames.back();
+        free_frames.pop_back();
+        return frame;
+    }
+
+    // Reloj (segunda oportunidad) sobre los bloques no fijados: en dos vueltas
+    // los bits de referencia ya se han limpiado
+    for (size_t step = 0; step < 2 * payload_frames; ++step) {
+        size_t frame = clock_hand;
+        clock_hand = (clock_hand + 1) % payload_frames;
+        size_t block_index = frame_block[frame];
+        if (block_index == recent_blocks[0] || block_index == recent_blocks[1] || block_pins[block_index] > 0) {
+            continue;
+        }
+        if (frame_flags[frame] & FRAME_REFERENCED) {
+            frame_flags[frame] &= static_cast<uint8_t>(~FRAME_REFERENCED);
+            continue;
+        }
+        if (evict_frame(frame)) {
+            return frame;
+        }
+    }
+
+    // Solo quedan bloques fijados: el presupuesto no cubre las versiones actuales
+    for (size_t step = 0; step < payload_frames; ++step) {
+        size_t frame = clock_hand;
+        clock_hand = (clock_hand + 1) % payload_frames;
+        size_t block_index = frame_block[frame];
+        if (block_index == recent_blocks[0] || block_index == recent_blocks[1]) {
+            continue;
+        }
+        bool pinned = block_pins[block_index] > 0;
+        if (evict_frame(frame)) {
+            if (pinned) {
+                if (tiering_counters.pinned_evictions == 0) {
+                    COWFS_LOG_WARN("Tiering: RAM budget is smaller than the current versions; evicting pinned blocks");
+                }
+                tiering_counters.pinned_evictions++;
+            }
+            return frame;
+        }
+    }
+    throw std::runtime_error("Tiering: no block could be evicted to the backing store");
+}
+
+bool COWFileSystem::evict_frame(size_t frame) {
+    size_t block_index = frame_block[frame];
+    Block& block = blocks[block_index];
+    if (frame_flags[frame] & FRAME_DIRTY) {
+        if (!pwrite_full(backing_fd, block.data, BLOCK_SIZE, backing_offset(block_index))) {
+            COWFS_LOG_ERROR("Tiering: Could not write block " << block_index << " to the backing store");
+            return false;
+        }
+        block_on_backing[block_index] = true;
+        tiering_counters.writebacks++;
+    }
+    // La copia que se lea del almacen se vuelve a verificar
+    block.data = nullptr;
+    block.checksum_verified = false;
+    frame_block[frame] = 0;
+    frame_flags[frame] = 0;
+    tiering_counters.evictions++;
+    tiering_counters.resident_blocks--;
+    return true;
+}
+
+void COWFileSystem::release_block_frame(size_t block_index) {
+    if (!tiering_enabled) {
+        return;
+    }
+    block_on_backing[block_index] = false;
+    Block& block = blocks[block_index];
+    if (!block.data) {
+        return;
+    }
+    size_t frame = payload_arena.index_of(block.data);
+    frame_block[frame] = 0;
+    frame_flags[frame] = 0;
+    free_frames.push_back(frame);
+    block.data = nullptr;
+    tiering_counters.resident_blocks--;
+}
+
+bool COWFileSystem::read_backing(size_t block_index, uint8_t* out) const {
+    const Block& block = blocks[block_index];
+    if (block.data) {
+        std::memcpy(out, block.data, BLOCK_SIZE);
+        return true;
+    }
+    if (!tiering_enabled || !block_on_backing[block_index]) {
+        std::memset(out, 0, BLOCK_SIZE);
+        return true;
+    }
+    return pread_full(backing_fd, out, BLOCK_SIZE, backing_offset(block_index));
+}
+
+const uint8_t* COWFileSystem::peek_block(size_t block_index, uint8_t* scratch) const {
+    if (blocks[block_index].data) {
+        return blocks[block_index].data;
+    }
+    if (!read_backing(block_index, scratch)) {
+        // Igual que en block_data(): el CRC detectara el contenido perdido
+        COWFS_LOG_ERROR("Tiering: Could not read block " << block_index << " from the backing store");
+        std::memset(scratch, 0, BLOCK_SIZE);
+    }
+    return scratch;
+}
+
+void COWFileSystem::refresh_head_pins(const Inode& inode) {
+    if (!tiering_enabled) {
+        return;
+    }
+    auto& pins = head_pins[static_cast<size_t>(&inode - inodes.data())];
+    for (size_t block_index : pins) {
+        if (--block_pins[block_index] == 0) {
+            tiering_counters.pinned_blocks--;
+        }
+    }
+    pins.clear();
+
+    // La version actual lee tambien el prefijo guardado en versiones anteriores
+    std::vector<ChainExtent> extents;
+    if (!inode.is_used || inode.version_history.empty() ||
+        !version_extents(inode, inode.version_history.size() - 1, extents)) {
+        return;
+    }
+    for (const auto& extent : extents) {
+        if (!pins.empty() && pins.back() == extent.block) {
+            continue;
+        }
+        pins.push_back(extent.block);
+        if (block_pins[extent.block]++ == 0) {
+            tiering_counters.pinned_blocks++;
+        }
+    }
+}
+
+size_t COWFileSystem::release_unused_memory() {
+    if (tiering_enabled || payload_arena.status().locked || payload_arena.status().prefaulted) {
+        // Los marcos libres se reutilizan: el presupuesto ya limita la arena.
+        // Las paginas bloqueadas con mlock no se pueden descartar, y las de
+        // una arena con prefault se pidieron ocupadas de antemano
+        return 0;
+    }
+    size_t resident_before = payload_arena.resident();
+    const size_t chunk_frames = payload_arena.frames_per_chunk();
+    for (size_t chunk = 0; chunk < payload_arena.chunk_count(); ++chunk) {
+        if (!payload_arena.chunk_committed(chunk)) {
+            continue;
+        }
+        size_t first = chunk * chunk_frames;
+        size_t last = std::min(first + chunk_frames, blocks.size());
+        bool in_use = false;
+        for (size_t i = first; i < last && !in_use; ++i) {
+            in_use = blocks[i].is_used;
+        }
+
+        if (!in_use) {
+            for (size_t i = first; i < last; ++i) {
+                blocks[i].data = nullptr;
+            }
+            payload_arena.release_chunk(chunk);
+            // Las cabeceras de bloques libres sin marco valen cero salvo el
+            // CRC, que no se usa hasta volver a escribir el bloque
+            discard_pages(&blocks[first], blocks.data() + last);
+            forget_header_pages(first, last);
+            continue;
+        }
+
+        // Trozo con bloques en uso: solo se descartan las paginas de los
+        // huecos libres, que se releen como ceros
+        size_t i = first;
+        while (i < last) {
+            if (blocks[i].is_used) {
+                i++;
+                continue;
+            }
+            size_t run_end = i;
+            while (run_end < last && !blocks[run_end].is_used) {
+                run_end++;
+            }
+            discard_pages(payload_arena.frame(i), payload_arena.frame(run_end));
+            i = run_end;
+        }
+    }
+
+    size_t resident_after = payload_arena.resident();
+    size_t released = resident_before > resident_after ? resident_before - resident_after : 0;
+    if (released > 0) {
+        COWFS_LOG_INFO("Released " << released << " bytes of unused block memory");
+    }
+    return released;
+}
+
+BlockArenaStatus COWFileSystem::arena_status() const {
+    return BlockArenaStatus{payload_arena.status(), header_arena};
+}
+
+void COWFileSystem::log_arena_status() const {
+    const ArenaStatus& content = payload_arena.status();
+    if (content.huge_pages == HugePages::NONE && !content.prefaulted && !content.locked &&
+        header_arena.huge_pages == HugePages::NONE) {
+        return;
+    }
+    COWFS_LOG_INFO("Block arena: " << huge_pages_name(content.huge_pages) << " huge pages for content, "
+                   << huge_pages_name(header_arena.huge_pages) << " for headers"
+                   << (content.prefaulted ? ", prefaulted" : "") << (content.locked ? ", locked" : ""));
+}
+
+TieringStats COWFileSystem::tiering_stats() const {
+    return tiering_enabled ? tiering_counters : TieringStats();
+}
+
+} // namespace cowfs
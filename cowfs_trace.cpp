@@ -0,0 +1,133 @@
+#include "cowfs_trace.hpp"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cowfs {
+namespace trace {
+
+namespace {
+
+struct Event {
+    const char* name;
+    int64_t start_ns;
+    int64_t duration_ns;
+};
+
+// Buffer de eventos de un hilo. El mutex solo compite con dump/clear.
+struct ThreadBuffer {
+    uint32_t thread_id;
+    std::mutex mutex;
+    std::vector<Event> events;
+};
+
+std::atomic<bool> tracing_enabled{false};
+std::atomic<size_t> max_events{1 << 20};
+std::atomic<uint64_t> dropped{0};
+
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+std::mutex registry_mutex;
+// Los buffers sobreviven a sus hilos para poder volcarlos despues
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& local_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        created->thread_id = static_cast<uint32_t>(registry.size() + 1);
+        registry.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+int64_t since_epoch_ns(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - trace_epoch).count();
+}
+
+void write_microseconds(std::ostream& out, int64_t ns) {
+    out << ns / 1000 << "." << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+} // namespace
+
+void set_enabled(bool enabled) {
+    tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_enabled() {
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void clear() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : registry) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        buffer->events.clear();
+    }
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+void set_max_events_per_thread(size_t max_events_per_thread) {
+    max_events.store(max_events_per_thread, std::memory_order_relaxed);
+}
+
+uint64_t dropped_events() {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void dump_chrome_trace(std::ostream& out) {
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& buffer : registry) {
+        std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+        for (const auto& event : buffer->events) {
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"name\":\"" << event.name << "\",\"cat\":\"cowfs\",\"ph\":\"X\",\"ts\":";
+            write_microseconds(out, event.start_ns);
+            out << ",\"dur\":";
+            write_microseconds(out, event.duration_ns);
+            out << ",\"pid\":1,\"tid\":" << buffer->thread_id << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+bool dump_chrome_trace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        return false;
+    }
+    dump_chrome_trace(out);
+    return static_cast<bool>(out);
+}
+
+Span::Span(const char* name) : name(name), active(is_enabled()) {
+    if (active) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+Span::~Span() {
+    if (!active) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    ThreadBuffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= max_events.load(std::memory_order_relaxed)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    int64_t start_ns = since_epoch_ns(start);
+    buffer.events.push_back({name, start_ns, since_epoch_ns(end) - start_ns});
+}
+
+} // namespace trace
+} // namespace cowfs
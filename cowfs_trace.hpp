@@ -0,0 +1,61 @@
+#ifndef COWFS_TRACE_HPP
+#define COWFS_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Spans de trazado de las fases internas de las operaciones. Solo se
+// compilan si se define COWFS_ENABLE_TRACING; aun asi no registran nada
+// hasta que se llama a trace::set_enabled(true).
+
+namespace cowfs {
+namespace trace {
+
+void set_enabled(bool enabled);
+bool is_enabled();
+
+// Descarta todos los eventos acumulados en los buffers de todos los hilos
+void clear();
+
+// Maximo de eventos guardados por hilo; los que excedan se descartan
+void set_max_events_per_thread(size_t max_events);
+uint64_t dropped_events();
+
+/**
+ * @brief Escribe los eventos acumulados en formato Chrome trace-event JSON
+ *
+ * El resultado se puede abrir en chrome://tracing o en Perfetto.
+ */
+void dump_chrome_trace(std::ostream& out);
+bool dump_chrome_trace(const std::string& path);
+
+// Mide un intervalo con nombre; name debe ser un literal de cadena
+class Span {
+public:
+    explicit Span(const char* name);
+    ~Span();
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    const char* name;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+} // namespace trace
+} // namespace cowfs
+
+#define COWFS_TRACE_CONCAT_INNER(a, b) a##b
+#define COWFS_TRACE_CONCAT(a, b) COWFS_TRACE_CONCAT_INNER(a, b)
+
+#ifdef COWFS_ENABLE_TRACING
+#define COWFS_TRACE_SPAN(name) \
+    ::cowfs::trace::Span COWFS_TRACE_CONCAT(cowfs_trace_span_, __LINE__)(name)
+#else
+#define COWFS_TRACE_SPAN(name) ((void)0)
+#endif
+
+#endif // COWFS_TRACE_HPP
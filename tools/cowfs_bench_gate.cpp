@@ -0,0 +1,450 @@
+// Puerta de regresiones de rendimiento: ejecuta los benchmarks varias veces,
+// compara la mediana de cada resultado con la linea base guardada en el
+// repositorio (bench/baseline.json) y termina con codigo 1 si alguna de las
+// operaciones vigiladas (read, write, find_delta, allocate_block,
+// garbage_collect) es significativamente mas lenta o falta en la ejecucion.
+//
+// Para cada benchmark se guarda la mediana de cada ejecucion. El cambio se
+// mide como el cociente de las medianas de esas medianas, con un intervalo
+// de confianza del 95% por bootstrap. Hay regresion cuando el extremo
+// inferior del intervalo supera la tolerancia.
+//
+// Uso: cowfs_bench_gate [--baseline=bench/baseline.json] [--bench-dir=.]
+//                       [--runs=5] [--tolerance=0.05]
+//                       [--gate=read,write,find_delta,allocate_block,garbage_collect]
+//                       [--update-baseline]
+
+#include "bench/bench_common.hpp"
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const DEFAULT_BASELINE = "bench/baseline.json";
+constexpr int BASELINE_FORMAT = 1;
+constexpr size_t BOOTSTRAP_SAMPLES = 2000;
+
+// Valor JSON minimo: lo justo para las lineas de los benchmarks y la linea base
+struct JsonValue {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    // Los objetos conservan el orden de las claves
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* get(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text(text) {}
+
+    bool parse(JsonValue& value) {
+        return parse_value(value) && (skip_spaces(), pos == text.size());
+    }
+
+private:
+    const std::string& text;
+    size_t pos = 0;
+
+    void skip_spaces() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            pos++;
+        }
+    }
+
+    bool consume(char c) {
+        skip_spaces();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_string(std::string& out) {
+        if (!consume('"')) {
+            return false;
+        }
+        out.clear();
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                pos++;
+            }
+            out.push_back(text[pos++]);
+        }
+        return pos < text.size() && text[pos++] == '"';
+    }
+
+    bool parse_value(JsonValue& value) {
+        skip_spaces();
+        if (pos >= text.size()) {
+            return false;
+        }
+        char c = text[pos];
+        if (c == '{') {
+            value.type = JsonValue::OBJECT;
+            pos++;
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                std::pair<std::string, JsonValue> member;
+                if (!parse_string(member.first) || !consume(':') || !parse_value(member.second)) {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+            } while (consume(','));
+            return consume('}');
+        }
+        if (c == '[') {
+            value.type = JsonValue::ARRAY;
+            pos++;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                JsonValue item;
+                if (!parse_value(item)) {
+                    return false;
+                }
+                value.items.push_back(std::move(item));
+            } while (consume(','));
+            return consume(']');
+        }
+        if (c == '"') {
+            value.type = JsonValue::STRING;
+            return parse_string(value.text);
+        }
+        for (const char* word : {"true", "false", "null"}) {
+            if (text.compare(pos, std::strlen(word), word) == 0) {
+                value.type = word[0] == 'n' ? JsonValue::NUL : JsonValue::BOOL;
+                value.number = word[0] == 't' ? 1 : 0;
+                pos += std::strlen(word);
+                return true;
+            }
+        }
+        char* end = nullptr;
+        value.type = JsonValue::NUMBER;
+        value.number = std::strtod(text.c_str() + pos, &end);
+        if (end == text.c_str() + pos) {
+            return false;
+        }
+        pos = static_cast<size_t>(end - text.c_str());
+        return true;
+    }
+};
+
+struct Benchmark {
+    std::string program;
+    std::string args;
+};
+
+// Conjunto por defecto: rapido y centrado en las operaciones vigiladas
+const std::vector<Benchmark> DEFAULT_BENCHMARKS = {
+    {"bench_core", "--file-sizes=4K,64K --image-sizes=16M --iterations=30"},
+};
+
+// Mediana de cada ejecucion por benchmark, indexado por "suite/nombre parametros"
+using RunMedians = std::map<std::string, std::vector<double>>;
+
+struct Baseline {
+    std::vector<Benchmark> benchmarks;
+    RunMedians results;
+};
+
+std::string escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out;
+}
+
+// Clave de un resultado: suite/nombre seguido de los parametros, que el
+// Reporter escribe entre "name" y "samples"
+bool result_key(const JsonValue& line, std::string& key) {
+    const JsonValue* suite = line.get("suite");
+    const JsonValue* name = line.get("name");
+    if (line.type != JsonValue::OBJECT || !suite || !name) {
+        return false;
+    }
+    key = suite->text + "/" + name->text;
+    bool in_params = false;
+    for (const auto& member : line.members) {
+        if (member.first == "samples") {
+            break;
+        }
+        if (in_params) {
+            std::ostringstream param;
+            param << " " << member.first << "=" << static_cast<uint64_t>(member.second.number);
+            key += param.str();
+        }
+        if (member.first == "name") {
+            in_params = true;
+        }
+    }
+    return true;
+}
+
+bool run_benchmark(const std::string& bench_dir, const Benchmark& benchmark, RunMedians& medians) {
+    std::string command = bench_dir + "/" + benchmark.program + " " + benchmark.args + " --format=json";
+    std::unique_ptr<FILE, int (*)(FILE*)> pipe(popen(command.c_str(), "r"), pclose);
+    if (!pipe) {
+        std::cerr << "Could not run " << command << std::endl;
+        return false;
+    }
+    std::string line;
+    char chunk[4096];
+    size_t results = 0;
+    while (std::fgets(chunk, sizeof(chunk), pipe.get())) {
+        line += chunk;
+        if (line.empty() || line.back() != '\n') {
+            continue;
+        }
+        JsonValue value;
+        std::string key;
+        const JsonValue* median = nullptr;
+        if (JsonParser(line).parse(value) && result_key(value, key) &&
+            (median = value.get("median_ns")) != nullptr) {
+            medians[key].push_back(median->number);
+            results++;
+        }
+        line.clear();
+    }
+    int status = pclose(pipe.release());
+    if (status != 0 || results == 0) {
+        std::cerr << "Benchmark failed or produced no results: " << command << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool load_baseline(const std::string& path, Baseline& baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    JsonValue root;
+    std::string text = content.str();
+    if (!JsonParser(text).parse(root) || root.type != JsonValue::OBJECT) {
+        std::cerr << "Invalid baseline JSON: " << path << std::endl;
+        return false;
+    }
+    const JsonValue* format = root.get("format");
+    const JsonValue* benchmarks = root.get("benchmarks");
+    const JsonValue* results = root.get("results");
+    if (!format || static_cast<int>(format->number) != BASELINE_FORMAT || !benchmarks || !results) {
+        std::cerr << "Unsupported baseline format: " << path << std::endl;
+        return false;
+    }
+    for (const auto& item : benchmarks->items) {
+        const JsonValue* program = item.get("program");
+        const JsonValue* args = item.get("args");
+        if (program && args) {
+            baseline.benchmarks.push_back({program->text, args->text});
+        }
+    }
+    for (const auto& member : results->members) {
+        for (const auto& value : member.second.items) {
+            baseline.results[member.first].push_back(value.number);
+        }
+    }
+    return true;
+}
+
+bool save_baseline(const std::string& path, const Baseline& baseline) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+    out << std::fixed << std::setprecision(1);
+    out << "{\n  \"format\": " << BASELINE_FORMAT << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < baseline.benchmarks.size(); ++i) {
+        out << "    {\"program\": \"" << escape(baseline.benchmarks[i].program)
+            << "\", \"args\": \"" << escape(baseline.benchmarks[i].args) << "\"}"
+            << (i + 1 < baseline.benchmarks.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"results\": {\n";
+    size_t index = 0;
+    for (const auto& entry : baseline.results) {
+        out << "    \"" << escape(entry.first) << "\": [";
+        for (size_t i = 0; i < entry.second.size(); ++i) {
+            out << (i ? ", " : "") << entry.second[i];
+        }
+        out << "]" << (++index < baseline.results.size() ? "," : "") << "\n";
+    }
+    out << "  }\n}\n";
+    return static_cast<bool>(out);
+}
+
+double median_of(std::vector<double> values) {
+    return summarize(std::move(values)).median_ns;
+}
+
+// Intervalo de confianza del 95% del cambio relativo de la mediana
+// (actual / base - 1) por bootstrap con semilla fija
+std::pair<double, double> change_interval(const std::vector<double>& base,
+                                          const std::vector<double>& current) {
+    std::mt19937_64 rng(42);
+    std::vector<double> changes;
+    changes.reserve(BOOTSTRAP_SAMPLES);
+    std::vector<double> a(base.size());
+    std::vector<double> b(current.size());
+    for (size_t s = 0; s < BOOTSTRAP_SAMPLES; ++s) {
+        for (auto& value : a) {
+            value = base[rng() % base.size()];
+        }
+        for (auto& value : b) {
+            value = current[rng() % current.size()];
+        }
+        double base_median = median_of(a);
+        if (base_median > 0) {
+            changes.push_back(median_of(b) / base_median - 1.0);
+        }
+    }
+    if (changes.empty()) {
+        return {0.0, 0.0};
+    }
+    std::sort(changes.begin(), changes.end());
+    return {changes[changes.size() * 25 / 1000], changes[changes.size() * 975 / 1000]};
+}
+
+bool gated(const std::string& key, const std::vector<std::string>& gates) {
+    size_t slash = key.find('/');
+    std::string name = key.substr(slash == std::string::npos ? 0 : slash + 1);
+    for (const auto& gate : gates) {
+        if (name.compare(0, gate.size(), gate) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_usage() {
+    std::cout << "Usage: cowfs_bench_gate [options]\n"
+              << "  --baseline=FILE           baseline JSON (default " << DEFAULT_BASELINE << ")\n"
+              << "  --bench-dir=PATH          directory with the benchmark binaries (default .)\n"
+              << "  --runs=N                  runs of each benchmark (default 5)\n"
+              << "  --tolerance=FRACTION      allowed slowdown of the median (default 0.05)\n"
+              << "  --gate=LIST               benchmark name prefixes that fail the gate\n"
+              << "                            (default read,write,find_delta,allocate_block,garbage_collect)\n"
+              << "  --update-baseline         run the benchmarks and rewrite the baseline\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help")) {
+        print_usage();
+        return 0;
+    }
+    const std::string baseline_path = options.get_string("baseline", DEFAULT_BASELINE);
+    const std::string bench_dir = options.get_string("bench-dir", ".");
+    const size_t runs = std::max<size_t>(2, options.get_size("runs", 5));
+    const double tolerance = options.get_double("tolerance", 0.05);
+    const std::vector<std::string> gates =
+        options.get_strings("gate", "read,write,find_delta,allocate_block,garbage_collect");
+    const bool update = options.has("update-baseline");
+
+    Baseline baseline;
+    bool have_baseline = load_baseline(baseline_path, baseline);
+    if (!have_baseline && !update) {
+        std::cerr << "No baseline at " << baseline_path << " (run with --update-baseline)" << std::endl;
+        return 2;
+    }
+    if (baseline.benchmarks.empty()) {
+        baseline.benchmarks = DEFAULT_BENCHMARKS;
+    }
+
+    RunMedians current;
+    for (size_t run = 0; run < runs; ++run) {
+        for (const auto& benchmark : baseline.benchmarks) {
+            if (!run_benchmark(bench_dir, benchmark, current)) {
+                return 2;
+            }
+        }
+    }
+
+    if (update) {
+        baseline.results = current;
+        if (!save_baseline(baseline_path, baseline)) {
+            std::cerr << "Could not write " << baseline_path << std::endl;
+            return 2;
+        }
+        std::cout << "Baseline written to " << baseline_path << " (" << current.size()
+                  << " results, " << runs << " runs)" << std::endl;
+        return 0;
+    }
+
+    size_t regressions = 0;
+    std::cout << std::left << std::setw(62) << "benchmark" << std::right
+              << std::setw(14) << "base ns" << std::setw(14) << "current ns"
+              << std::setw(10) << "change" << std::setw(22) << "95% CI" << "  verdict\n";
+    for (const auto& entry : current) {
+        auto base = baseline.results.find(entry.first);
+        std::cout << std::left << std::setw(62) << entry.first << std::right << std::fixed;
+        if (base == baseline.results.end() || base->second.empty()) {
+            std::cout << std::setw(14) << "-" << std::setw(14) << std::setprecision(0)
+                      << median_of(entry.second) << std::setw(10) << "-" << std::setw(22) << "-"
+                      << "  new\n";
+            continue;
+        }
+        double base_median = median_of(base->second);
+        double current_median = median_of(entry.second);
+        double change = base_median > 0 ? current_median / base_median - 1.0 : 0.0;
+        std::pair<double, double> interval = change_interval(base->second, entry.second);
+
+        std::string verdict = "ok";
+        if (interval.first > tolerance) {
+            verdict = gated(entry.first, gates) ? "REGRESSION" : "slower";
+            regressions += gated(entry.first, gates) ? 1 : 0;
+        } else if (interval.second < -tolerance) {
+            verdict = "faster";
+        }
+
+        std::ostringstream ci;
+        ci << std::fixed << std::setprecision(1) << "[" << interval.first * 100 << "%, "
+           << interval.second * 100 << "%]";
+        std::cout << std::setprecision(0) << std::setw(14) << base_median << std::setw(14) << current_median
+                  << std::setprecision(1) << std::setw(9) << change * 100 << "%"
+                  << std::setw(22) << ci.str() << "  " << verdict << "\n";
+    }
+    // Un resultado vigilado que desaparece (renombrado, eliminado o que el
+    // programa deja de emitir) cuenta como fallo
+    size_t missing = 0;
+    for (const auto& entry : baseline.results) {
+        if (current.find(entry.first) == current.end()) {
+            bool is_gated = gated(entry.first, gates);
+            missing += is_gated ? 1 : 0;
+            std::cout << std::left << std::setw(62) << entry.first << "  missing from this run"
+                      << (is_gated ? " (MISSING)" : "") << "\n";
+        }
+    }
+
+    if (regressions > 0 || missing > 0) {
+        std::cout << regressions << " significant regression(s) above " << tolerance * 100
+                  << "% tolerance, " << missing << " gated result(s) missing" << std::endl;
+        return 1;
+    }
+    std::cout << "No significant regressions" << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Exporta todos los archivos de una imagen a un archivo tar leyendo los
+// bloques en orden fisico (COWFileSystem::export_archive).
+//
+// Uso: cowfs_export --image=IMAGE --image-size=SIZE --out=ARCHIVE.tar
+//                   [--versions=head|all] [--window=SIZE] [--compare]
+//
+// Con --compare repite la exportacion de las versiones actuales hacia un
+// destino que descarta los datos, y la compara con la lectura de cada
+// archivo por la API (open y read en orden logico) sin el coste del disco.
+
+#include "bench/bench_common.hpp"
+#include <fstream>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+void print_usage() {
+    std::cout << "Usage: cowfs_export --image=IMAGE --image-size=SIZE --out=ARCHIVE [options]\n"
+              << "  --versions=head|all       export the current version or every version (default: head)\n"
+              << "  --window=SIZE             content bytes buffered at a time (default: 1M)\n"
+              << "  --compare                 compare export_archive and read() on the current versions, without disk output\n"
+              << "  --verbose                 keep library logging on\n";
+}
+
+// Destino que solo cuenta los bytes recibidos
+class DiscardBuffer : public std::streambuf {
+protected:
+    int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Lectura de la version actual de cada archivo con open/read
+uint64_t read_all_files(COWFileSystem& fs) {
+    std::vector<std::string> names;
+    fs.list_files(names);
+    std::vector<uint8_t> buffer;
+    uint64_t bytes = 0;
+    for (const auto& name : names) {
+        fd_t fd = fs.open(name, FileMode::READ);
+        if (fd < 0) {
+            continue;
+        }
+        buffer.resize(fs.get_file_size(fd));
+        ssize_t result = fs.read(fd, buffer.data(), buffer.size());
+        if (result > 0) {
+            bytes += static_cast<uint64_t>(result);
+        }
+        fs.close(fd);
+    }
+    return bytes;
+}
+
+double megabytes_per_second(uint64_t bytes, double ns) {
+    return ns > 0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / (ns / 1e9) : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help") || !options.has("image") || !options.has("image-size") || !options.has("out")) {
+        print_usage();
+        return options.has("help") ? 0 : 2;
+    }
+    quiet_logging(options);
+
+    ExportOptions export_options;
+    export_options.scope = options.get_string("versions", "head") == "all" ? ExportScope::ALL_VERSIONS
+                                                                        : ExportScope::HEAD;
+    export_options.window_bytes = options.get_size("window", export_options.window_bytes);
+    try {
+        COWFileSystem fs(options.get_string("image", ""), options.get_size("image-size", 0));
+
+        std::vector<char> io_buffer(1 << 20);
+        std::ofstream out;
+        out.rdbuf()->pubsetbuf(io_buffer.data(), io_buffer.size());
+        out.open(options.get_string("out", ""), std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Could not open " << options.get_string("out", "") << std::endl;
+            return 2;
+        }
+
+        ExportStats stats;
+        bool ok = true;
+        double elapsed = time_ns([&]() { ok = fs.export_archive(out, export_options, &stats); });
+        if (!ok) {
+            std::cerr << "Export failed" << std::endl;
+            return 2;
+        }
+        std::cout << stats.entries << " entries, " << stats.content_bytes << " bytes, "
+                  << stats.block_reads << " block reads, " << stats.backward_jumps << " backward jumps, "
+                  << std::fixed << std::setprecision(1)
+                  << megabytes_per_second(stats.content_bytes, elapsed) << " MB/s\n";
+
+        if (options.has("compare")) {
+            DiscardBuffer discard;
+            std::ostream sink(&discard);
+            ExportOptions head_options = export_options;
+            head_options.scope = ExportScope::HEAD;
+            double export_elapsed = time_ns([&]() { fs.export_archive(sink, head_options, &stats); });
+            uint64_t bytes = 0;
+            double read_elapsed = time_ns([&]() { bytes = read_all_files(fs); });
+            std::cout << "current versions without disk output: export_archive "
+                      << megabytes_per_second(stats.content_bytes, export_elapsed) << " MB/s, read() "
+                      << megabytes_per_second(bytes, read_elapsed) << " MB/s\n";
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+}
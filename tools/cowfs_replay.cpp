@@ -0,0 +1,246 @@
+// Reproduce una traza grabada con COWFileSystem::start_recording() sobre una
+// imagen nueva e informa de la latencia de cada tipo de operacion.
+//
+// Las trazas no guardan el contenido escrito. Cada escritura se sintetiza a
+// partir del contenido actual del archivo: se conservan el prefijo hasta
+// delta_start y el sufijo comun, y el delta se rellena con bytes derivados
+// del hash grabado. Asi el nuevo contenido tiene el mismo tamano y produce
+// el mismo delta que la escritura original.
+//
+// Uso: cowfs_replay --trace=FILE [--image=PATH] [--image-size=SIZE]
+//                   [--repeat=N] [--format=json|text]
+
+#include "bench/bench_common.hpp"
+#include "cowfs_recorder.hpp"
+#include <filesystem>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+const char* const SUITE = "replay";
+constexpr size_t OP_SLOTS = static_cast<size_t>(TraceOp::GARBAGE_COLLECT) + 1;
+
+struct ReplayStats {
+    std::vector<double> latencies[OP_SLOTS];
+    // Operaciones cuyo resultado no coincide con el grabado
+    uint64_t divergent[OP_SLOTS] = {};
+};
+
+class Replayer {
+public:
+    Replayer(COWFileSystem& fs, ReplayStats& stats) : fs(fs), stats(stats) {}
+
+    void replay(const TraceRecord& record) {
+        size_t slot = static_cast<size_t>(record.op);
+        int64_t result = 0;
+        double elapsed = 0;
+
+        switch (record.op) {
+            case TraceOp::CREATE:
+            case TraceOp::OPEN: {
+                fd_t fd = -1;
+                if (record.op == TraceOp::CREATE) {
+                    elapsed = time_ns([&]() { fd = fs.create(record.name); });
+                } else {
+                    FileMode mode = static_cast<FileMode>(record.mode);
+                    elapsed = time_ns([&]() { fd = fs.open(record.name, mode); });
+                }
+                result = fd;
+                if (fd >= 0 && record.fd >= 0) {
+                    fds[record.fd] = fd;
+                    names[record.fd] = record.name;
+                }
+                // El resultado es un descriptor: solo importa si hubo error
+                if ((fd >= 0) != (record.result >= 0)) {
+                    stats.divergent[slot]++;
+                }
+                stats.latencies[slot].push_back(elapsed);
+                return;
+            }
+            case TraceOp::READ: {
+                buffer.resize(record.size);
+                fd_t fd = map_fd(record.fd);
+                elapsed = time_ns([&]() { result = fs.read(fd, buffer.data(), buffer.size()); });
+                break;
+            }
+            case TraceOp::WRITE: {
+                fd_t fd = map_fd(record.fd);
+                synthesize_write(record);
+                elapsed = time_ns([&]() { result = fs.write(fd, buffer.data(), buffer.size()); });
+                break;
+            }
+            case TraceOp::CLOSE: {
+                fd_t fd = map_fd(record.fd);
+                elapsed = time_ns([&]() { result = fs.close(fd); });
+                fds.erase(record.fd);
+                names.erase(record.fd);
+                break;
+            }
+            case TraceOp::ROLLBACK: {
+                fd_t fd = map_fd(record.fd);
+                elapsed = time_ns([&]() { result = fs.rollback_to_version(fd, record.version) ? 1 : 0; });
+                break;
+            }
+            case TraceOp::GARBAGE_COLLECT:
+                elapsed = time_ns([&]() { fs.garbage_collect(); });
+                break;
+        }
+
+        if (result != record.result) {
+            stats.divergent[slot]++;
+        }
+        stats.latencies[slot].push_back(elapsed);
+    }
+
+private:
+    COWFileSystem& fs;
+    ReplayStats& stats;
+    std::map<int64_t, fd_t> fds;
+    std::map<int64_t, std::string> names;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> current;
+
+    fd_t map_fd(int64_t recorded) const {
+        auto it = fds.find(recorded);
+        return it == fds.end() ? -1 : it->second;
+    }
+
+    // Contenido actual del archivo, leido sin medir con un descriptor propio
+    void load_current(int64_t recorded_fd) {
+        current.clear();
+        auto it = names.find(recorded_fd);
+        if (it == names.end()) {
+            return;
+        }
+        fd_t fd = fs.open(it->second, FileMode::READ);
+        if (fd < 0) {
+            return;
+        }
+        current.resize(fs.get_file_size(fd));
+        ssize_t bytes = current.empty() ? 0 : fs.read(fd, current.data(), current.size());
+        current.resize(bytes > 0 ? static_cast<size_t>(bytes) : 0);
+        fs.close(fd);
+    }
+
+    void synthesize_write(const TraceRecord& record) {
+        load_current(record.fd);
+        const size_t size = record.size;
+        const size_t old_size = current.size();
+        buffer.assign(size, 0);
+
+        // Si la imagen diverge de la grabacion se ajusta el delta a lo posible
+        size_t delta_start = std::min<size_t>(record.offset, std::min(old_size, size));
+        size_t delta_size = std::min<size_t>(record.delta_size, size - delta_start);
+        size_t suffix = std::min(size - delta_start - delta_size, old_size - delta_start);
+
+        std::copy(current.begin(), current.begin() + delta_start, buffer.begin());
+        std::copy(current.end() - suffix, current.end(), buffer.end() - suffix);
+
+        std::mt19937_64 rng(record.content_hash);
+        for (size_t i = delta_start; i < delta_start + delta_size; ++i) {
+            buffer[i] = static_cast<uint8_t>(rng());
+        }
+        // Los extremos del delta deben diferir del contenido anterior para que
+        // find_delta encuentre exactamente el mismo rango
+        if (delta_size > 0) {
+            if (delta_start < old_size && buffer[delta_start] == current[delta_start]) {
+                buffer[delta_start] ^= 0x5A;
+            }
+            size_t last = delta_start + delta_size - 1;
+            size_t old_last = old_size - suffix - 1;
+            if (old_size > suffix && old_last >= delta_start && buffer[last] == current[old_last]) {
+                buffer[last] ^= 0x5A;
+            }
+        }
+    }
+};
+
+void print_usage() {
+    std::cout << "Usage: cowfs_replay --trace=FILE [options]\n"
+              << "  --trace=FILE              trace written by COWFileSystem::start_recording()\n"
+              << "  --image=PATH              image to replay against (default cowfs_replay.img; must not exist, removed at exit)\n"
+              << "  --image-size=SIZE         image size (default: size of the recorded image)\n"
+              << "  --repeat=N                replay the trace N times, each on a fresh image (default 1)\n"
+              << "  --format=json|text        output format (default json)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help") || !options.has("trace")) {
+        print_usage();
+        return options.has("help") ? 0 : 1;
+    }
+    quiet_logging(options);
+
+    const std::string trace_path = options.get_string("trace", "");
+    TraceReader probe(trace_path);
+    if (!probe.is_open()) {
+        std::cerr << "Invalid or missing trace: " << trace_path << std::endl;
+        return 1;
+    }
+    const std::string image_path = options.get_string("image", "cowfs_replay.img");
+    const size_t image_size = options.get_size("image-size", probe.disk_size());
+    const size_t repeat = std::max<size_t>(1, options.get_size("repeat", 1));
+    // La imagen se borra entre repeticiones: solo se acepta una ruta que
+    // no exista, para no destruir nunca un archivo del usuario
+    std::error_code status_error;
+    auto image_status = std::filesystem::symlink_status(image_path, status_error);
+    if (image_status.type() != std::filesystem::file_type::not_found) {
+        std::cerr << "Refusing to replay over existing image: " << image_path << std::endl;
+        return 1;
+    }
+
+    ReplayStats stats;
+    std::vector<double> totals;
+    uint64_t records = 0;
+    try {
+        for (size_t r = 0; r < repeat; ++r) {
+            {
+                COWFileSystem fs(image_path, image_size);
+                Replayer replayer(fs, stats);
+                TraceReader reader(trace_path);
+                TraceRecord record;
+                records = 0;
+                totals.push_back(time_ns([&]() {
+                    while (reader.next(record)) {
+                        replayer.replay(record);
+                        records++;
+                    }
+                }));
+            }
+            std::remove(image_path.c_str());
+        }
+    } catch (const std::exception& e) {
+        std::remove(image_path.c_str());
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    Reporter reporter(options);
+    for (size_t slot = 1; slot < OP_SLOTS; ++slot) {
+        if (stats.latencies[slot].empty()) {
+            continue;
+        }
+        Result result;
+        result.suite = SUITE;
+        result.name = trace_op_name(static_cast<TraceOp>(slot));
+        result.params.emplace_back("image_size", image_size);
+        result.summary = summarize(stats.latencies[slot]);
+        result.metrics.emplace_back("divergent", static_cast<double>(stats.divergent[slot]));
+        reporter.report(result);
+    }
+
+    // Tiempo total de cada repeticion, incluida la sintesis de contenido
+    Result total;
+    total.suite = SUITE;
+    total.name = "trace";
+    total.params.emplace_back("image_size", image_size);
+    total.params.emplace_back("records", records);
+    total.summary = summarize(totals);
+    reporter.report(total);
+    return 0;
+}
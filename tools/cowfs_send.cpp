@@ -0,0 +1,93 @@
+// Replica una imagen en otra enviando solo las versiones que le faltan:
+// toma la instantanea del destino como base, genera el flujo incremental
+// desde el origen y lo aplica en el destino. Los archivos cuya historia
+// diverge (rollback en el origen) se reenvian completos.
+//
+// Uso: cowfs_send --source=IMAGE --target=IMAGE --image-size=SIZE
+//                 [--image-size-target=SIZE] [--stream=PATH]
+//
+// Codigo de salida: 0 si el destino queda igual que el origen, 1 si no y 2
+// si fallo el envio o la recepcion.
+
+#include "bench/bench_common.hpp"
+#include <fstream>
+
+using namespace cowfs;
+using namespace cowfs::bench;
+
+namespace {
+
+void print_usage() {
+    std::cout << "Usage: cowfs_send --source=IMAGE --target=IMAGE --image-size=SIZE [options]\n"
+              << "  --image-size=SIZE         size of the source (and target unless --image-size-target is given)\n"
+              << "  --image-size-target=SIZE  size of the target image\n"
+              << "  --stream=PATH             also keep the stream in PATH\n"
+              << "  --verbose                 keep library logging on\n";
+}
+
+bool same_snapshot(const Snapshot& a, const Snapshot& b) {
+    if (a.files.size() != b.files.size()) {
+        return false;
+    }
+    for (const auto& entry : a.files) {
+        auto other = b.files.find(entry.first);
+        if (other == b.files.end() || other->second.version != entry.second.version ||
+            other->second.digest != entry.second.digest) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options(argc, argv);
+    if (options.has("help") || !options.has("source") || !options.has("target") || !options.has("image-size")) {
+        print_usage();
+        return options.has("help") ? 0 : 2;
+    }
+    quiet_logging(options);
+
+    const size_t source_size = options.get_size("image-size", 0);
+    const size_t target_size = options.get_size("image-size-target", source_size);
+    try {
+        COWFileSystem source(options.get_string("source", ""), source_size);
+        COWFileSystem target(options.get_string("target", ""), target_size);
+
+        Snapshot from = target.snapshot();
+        Snapshot to = source.snapshot();
+        std::stringstream stream;
+        if (!source.send(from, to, stream)) {
+            std::cerr << "Send failed" << std::endl;
+            return 2;
+        }
+        const std::string bytes = stream.str();
+        if (options.has("stream")) {
+            std::ofstream file(options.get_string("stream", ""), std::ios::binary);
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        size_t changed = 0;
+        for (const auto& entry : to.files) {
+            auto base = from.files.find(entry.first);
+            if (base == from.files.end() || base->second.version != entry.second.version ||
+                base->second.digest != entry.second.digest) {
+                changed++;
+            }
+        }
+        if (!target.receive(stream)) {
+            std::cerr << "Receive failed" << std::endl;
+            return 2;
+        }
+
+        bool same = same_snapshot(target.snapshot(), to);
+        std::cout << to.files.size() << " files, " << changed << " sent, "
+                  << bytes.size() << " stream bytes, target "
+                  << (same ? "matches" : "does not match") << " the source\n";
+        return same ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+}